@@ -3,10 +3,18 @@
  * @brief Simple character device driver implementation
  *
  * This file implements a basic character device driver that:
- * - Creates a device file (/dev/simple_dev)
- * - Allocates a memory buffer to store data
- * - Implements read/write operations for user space interaction
+ * - Creates one or more device files (/dev/simple_dev0..N-1), each with
+ *   its own buffer and locks
+ * - Creates /dev/simple_priv, where every open() gets a private buffer
+ * - Stores data in lazily allocated pages up to a configurable capacity
+ * - Implements read/write operations for user space interaction, including
+ *   vectored I/O (readv/writev, io_uring) and splice()/sendfile()
+ * - Maps the buffer into user space with mmap() for zero-copy access
+ * - Optionally works as a streaming FIFO backed by a lock-free SPSC ring
+ * - Supports blocking I/O, O_NONBLOCK and poll()/epoll() via wait queues
  * - Handles synchronization for concurrent access
+ * - Provides tracepoints for open/release/read/write instead of logging
+ * - Keeps per-CPU statistics exported through debugfs
  */
 
 #include <linux/module.h>    /* For MODULE_ macros */
@@ -15,38 +23,127 @@
 #include <linux/cdev.h>      /* For character device functions */
 #include <linux/device.h>    /* For device_create/class_create */
 #include <linux/uaccess.h>   /* For copy_to/from_user */
-#include <linux/slab.h>      /* For kmalloc, kfree */
+#include <linux/slab.h>      /* For kmem_cache, kvzalloc, kvfree */
 #include <linux/mutex.h>     /* For mutex operations */
+#include <linux/rwsem.h>     /* For rw_semaphore operations */
+#include <linux/mm.h>        /* For vm_area_struct, vm_fault */
+#include <linux/gfp.h>       /* For alloc_page */
+#include <linux/xarray.h>    /* For the page array */
+#include <linux/sizes.h>     /* For SZ_1G */
+#include <linux/moduleparam.h> /* For module_param */
+#include <linux/log2.h>      /* For rounddown_pow_of_two */
+#include <linux/wait.h>      /* For wait queues */
+#include <linux/poll.h>      /* For poll_wait, EPOLL* */
+#include <linux/uio.h>       /* For iov_iter, copy_to/from_iter */
+#include <linux/splice.h>    /* For copy_splice_read, iter_file_splice_write */
+#include <linux/ktime.h>     /* For ktime_get_ns */
+#include <linux/percpu.h>    /* For per-CPU statistics */
+#include <linux/debugfs.h>   /* For debugfs files */
+#include <linux/seq_file.h>  /* For seq_printf */
+
+#include "simple_driver.h"   /* Shared ioctl definitions */
+
+#define CREATE_TRACE_POINTS
+#include "simple_driver_trace.h" /* Tracepoint definitions */
 
 /* Module information and constants */
 #define DRIVER_NAME     "simple_dev"    /* Device name in /dev */
+#define PRIV_NAME       "simple_priv"   /* Per-open private buffer device */
 #define DRIVER_CLASS    "simple"        /* Device class name */
-#define BUFFER_SIZE     PAGE_SIZE       /* Size of data buffer (4KB) */
+#define MAX_CAPACITY    SZ_1G           /* Upper bound for capacity */
+#define MAX_DEVS        256             /* Upper bound for nr_devs */
+
+/* Number of independent device instances (minors) */
+static unsigned int nr_devs = 1;
+module_param(nr_devs, uint, 0444);
+MODULE_PARM_DESC(nr_devs, "Number of /dev/simple_devN instances (default: 1)");
+
+/* Streaming FIFO mode instead of a flat, seekable buffer */
+static bool fifo_mode;
+module_param(fifo_mode, bool, 0444);
+MODULE_PARM_DESC(fifo_mode, "Use the buffer as a streaming FIFO (default: off)");
+
+/* Buffer capacity in bytes */
+static unsigned long capacity = PAGE_SIZE;
+module_param(capacity, ulong, 0444);
+MODULE_PARM_DESC(capacity, "Buffer capacity in bytes, rounded to pages "
+                 "(power of two in FIFO mode) (default: 4096)");
 
 /**
- * Device structure holding all driver state information.
- * This is better than using separate global variables.
+ * I/O, fault and lock-wait counters of one device, or of all private
+ * instances. Readers holding dev->lock shared run in parallel, so every
+ * CPU counts into its own copy instead of bouncing one cache line between
+ * them; sdev_stats_show() adds the copies up.
+ */
+struct sdev_stats {
+    u64 read_ops;                 /* Completed read calls */
+    u64 write_ops;                /* Completed write calls */
+    u64 read_bytes;               /* Bytes returned by reads */
+    u64 write_bytes;              /* Bytes accepted by writes */
+    u64 efault;                   /* Calls that failed with -EFAULT */
+    u64 erestartsys;              /* Calls interrupted by a signal */
+    u64 lock_contended;           /* Lock acquisitions that had to wait */
+    u64 lock_wait_ns;             /* Total time spent waiting for locks */
+};
+
+/**
+ * Device structure holding all per-minor driver state information.
+ * Instances come from a cache-line aligned slab cache so that the hot
+ * fields of neighbouring devices never share a cache line.
  */
 struct simple_dev {
-    struct mutex lock;            /* Mutex to protect concurrent access */
-    unsigned char *buffer;        /* Memory buffer to store data */
+    struct rw_semaphore lock;     /* Shared for readers, exclusive for writers */
+    struct xarray pages;          /* Buffer pages, allocated on first write */
+    size_t capacity;              /* Maximum amount of data in buffer */
     size_t size;                  /* Current amount of data in buffer */
+    bool fifo;                    /* Streaming FIFO instead of flat buffer */
+    bool priv;                    /* Private to a single open file */
     dev_t dev_num;                /* Device number (major+minor) */
     struct cdev cdev;             /* Character device structure */
-    struct class *class;          /* Device class */
     struct device *device;        /* Device structure */
+    struct sdev_stats __percpu *stats; /* Operation counters */
+    wait_queue_head_t read_wq;    /* Readers waiting for data */
+    wait_queue_head_t write_wq;   /* Writers waiting for FIFO space */
+
+    /*
+     * FIFO mode state. A power-of-two ring is used as a single-producer/
+     * single-consumer queue with free-running head and tail indices.
+     * Readers and writers only serialize among themselves, and each
+     * side lives on its own cache line so they never share a lock.
+     */
+    unsigned char *ring;          /* Ring storage (capacity bytes) */
+    struct mutex read_lock ____cacheline_aligned_in_smp; /* Serializes readers */
+    unsigned int tail;            /* Next byte to read (reader owned) */
+    struct mutex write_lock ____cacheline_aligned_in_smp; /* Serializes writers */
+    unsigned int head;            /* Next byte to write (writer owned) */
 };
 
-/* Global instance of our device */
-static struct simple_dev dev;
+/* Driver-wide state shared by all instances */
+static dev_t sdev_base;                  /* First device number */
+static struct class *sdev_class;         /* Device class */
+static struct kmem_cache *sdev_cache;    /* Slab cache for struct simple_dev */
+static struct simple_dev **sdev_devices; /* Instances, indexed by minor */
+
+/* Private buffer device, minor nr_devs */
+static struct cdev sdev_priv_cdev;       /* Character device structure */
+static struct device *sdev_priv_device;  /* Device structure */
+static struct kmem_cache *sdev_priv_cache; /* Pool of private instances */
+static struct sdev_stats __percpu *sdev_priv_stats; /* Shared by all private instances */
+
+/* debugfs directory with statistics (may be an error pointer) */
+static struct dentry *sdev_debugfs;
 
 /* Forward declarations for file operations */
 static int sdev_open(struct inode *inode, struct file *file);
 static int sdev_release(struct inode *inode, struct file *file);
-static ssize_t sdev_read(struct file *file, char __user *buf, 
-                         size_t count, loff_t *pos);
-static ssize_t sdev_write(struct file *file, const char __user *buf,
-                          size_t count, loff_t *pos);
+static loff_t sdev_llseek(struct file *file, loff_t offset, int whence);
+static ssize_t sdev_read_iter(struct kiocb *iocb, struct iov_iter *to);
+static ssize_t sdev_write_iter(struct kiocb *iocb, struct iov_iter *from);
+static int sdev_mmap(struct file *file, struct vm_area_struct *vma);
+static long sdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+static __poll_t sdev_poll(struct file *file, poll_table *wait);
+static struct simple_dev *sdev_priv_alloc(void);
+static void sdev_priv_free(struct simple_dev *dev);
 
 /**
  * File operations structure defining the driver's capabilities.
@@ -56,26 +153,49 @@ static const struct file_operations simple_fops = {
     .owner = THIS_MODULE,     /* Module that owns this structure */
     .open = sdev_open,        /* Called on open() */
     .release = sdev_release,  /* Called on close() */
-    .read = sdev_read,        /* Called on read() */
-    .write = sdev_write,      /* Called on write() */
+    .llseek = sdev_llseek,    /* Called on lseek() */
+    .read_iter = sdev_read_iter,   /* Called on read()/readv() */
+    .write_iter = sdev_write_iter, /* Called on write()/writev() */
+    .splice_read = copy_splice_read,        /* Device to pipe */
+    .splice_write = iter_file_splice_write, /* Pipe to device */
+    .mmap = sdev_mmap,        /* Called on mmap() */
+    .poll = sdev_poll,        /* Called on poll()/select()/epoll() */
+    .unlocked_ioctl = sdev_ioctl,     /* Called on ioctl() */
+    .compat_ioctl = compat_ptr_ioctl, /* 32-bit ioctl() on 64-bit kernel */
 };
 
 /**
  * @brief Handler for device open() operation
  *
- * Called when a process opens our device file.
+ * Called when a process opens our device file. Opens of the shared
+ * minors use that minor's instance, while every open of /dev/simple_priv
+ * gets a fresh private instance that nobody else can see.
  *
  * @param inode Pointer to inode structure of the device
  * @param file Pointer to file structure for this open instance
- * @return 0 on success
+ * @return 0 on success, or negative error code
  */
 static int sdev_open(struct inode *inode, struct file *file)
 {
+    struct simple_dev *dev;
+    
+    if (inode->i_cdev == &sdev_priv_cdev) {
+        dev = sdev_priv_alloc();
+        if (!dev)
+            return -ENOMEM;  /* Out of memory error */
+    } else {
+        dev = container_of(inode->i_cdev, struct simple_dev, cdev);
+    }
+    
     /* Store our device data in the file's private_data for later use */
-    file->private_data = &dev;
+    file->private_data = dev;
+    
+    /* Trace the open operation (no logging on this hot path) */
+    trace_simple_dev_open(inode->i_rdev, dev->priv);
     
-    /* Log the open operation */
-    pr_info("simple_driver: Device opened\n");
+    /* A FIFO has no file position, so mark the file as a stream */
+    if (dev->fifo)
+        return stream_open(inode, file);
     return 0;
 }
 
@@ -90,178 +210,1349 @@ static int sdev_open(struct inode *inode, struct file *file)
  */
 static int sdev_release(struct inode *inode, struct file *file)
 {
-    /* Log the close operation */
-    pr_info("simple_driver: Device closed\n");
+    struct simple_dev *dev = file->private_data;
+    
+    /* Trace the close operation (no logging on this hot path) */
+    trace_simple_dev_release(inode->i_rdev, dev->priv);
+    
+    /* Return private instances to the pool */
+    if (dev->priv)
+        sdev_priv_free(dev);
+    
     return 0;
 }
 
 /**
- * @brief Handler for device read() operation
+ * @brief Account the result of a read or write in the per-CPU counters
  *
- * Copies data from our kernel buffer to user space.
+ * @param dev Device the operation was performed on
+ * @param write true for writes, false for reads
+ * @param ret Return value of the operation
+ */
+static void sdev_stats_account(struct simple_dev *dev, bool write, ssize_t ret)
+{
+    if (ret >= 0) {
+        if (write) {
+            this_cpu_inc(dev->stats->write_ops);
+            this_cpu_add(dev->stats->write_bytes, ret);
+        } else {
+            this_cpu_inc(dev->stats->read_ops);
+            this_cpu_add(dev->stats->read_bytes, ret);
+        }
+    } else if (ret == -EFAULT) {
+        this_cpu_inc(dev->stats->efault);
+    } else if (ret == -ERESTARTSYS) {
+        this_cpu_inc(dev->stats->erestartsys);
+    }
+}
+
+/**
+ * @brief Account a lock acquisition that had to wait
  *
- * @param file Pointer to file structure
- * @param buf User space buffer to copy data to
- * @param count Number of bytes to read
- * @param pos Current position in file
+ * @param dev Device owning the lock
+ * @param start ktime_get_ns() value taken before waiting
+ */
+static void sdev_stats_contended(struct simple_dev *dev, u64 start)
+{
+    this_cpu_inc(dev->stats->lock_contended);
+    this_cpu_add(dev->stats->lock_wait_ns, ktime_get_ns() - start);
+}
+
+/**
+ * @brief Take dev->lock shared, recording contention
+ *
+ * The uncontended case is a single trylock; the clock is only read
+ * when the caller actually has to wait.
+ *
+ * @param dev Device to lock
+ * @return 0 on success, or -EINTR if interrupted by a signal
+ */
+static int sdev_down_read(struct simple_dev *dev)
+{
+    u64 start;
+    int ret;
+    
+    if (down_read_trylock(&dev->lock))
+        return 0;
+    
+    start = ktime_get_ns();
+    ret = down_read_interruptible(&dev->lock);
+    sdev_stats_contended(dev, start);
+    return ret;
+}
+
+/**
+ * @brief Take dev->lock exclusive, recording contention
+ *
+ * @param dev Device to lock
+ * @return 0 on success, or -EINTR if killed
+ */
+static int sdev_down_write(struct simple_dev *dev)
+{
+    u64 start;
+    int ret;
+    
+    if (down_write_trylock(&dev->lock))
+        return 0;
+    
+    start = ktime_get_ns();
+    ret = down_write_killable(&dev->lock);
+    sdev_stats_contended(dev, start);
+    return ret;
+}
+
+/**
+ * @brief Take one of the FIFO side mutexes, recording contention
+ *
+ * @param dev Device owning the mutex
+ * @param lock dev->read_lock or dev->write_lock
+ * @return 0 on success, or -EINTR if interrupted by a signal
+ */
+static int sdev_mutex_lock(struct simple_dev *dev, struct mutex *lock)
+{
+    u64 start;
+    int ret;
+    
+    if (mutex_trylock(lock))
+        return 0;
+    
+    start = ktime_get_ns();
+    ret = mutex_lock_interruptible(lock);
+    sdev_stats_contended(dev, start);
+    return ret;
+}
+
+/**
+ * @brief Wake up tasks sleeping on a wait queue
+ *
+ * Skips the wait queue lock entirely when nobody is waiting, which is
+ * the common case for a busy stream. The barrier in wq_has_sleeper()
+ * pairs with the one in prepare_to_wait() used by wait_event_*().
+ *
+ * @param wq Wait queue to wake
+ */
+static inline void sdev_wake(wait_queue_head_t *wq)
+{
+    if (wq_has_sleeper(wq))
+        wake_up_interruptible(wq);
+}
+
+/**
+ * @brief Number of bytes currently queued in the FIFO ring
+ *
+ * @param dev Device to inspect
+ * @return Bytes between tail and head
+ */
+static inline unsigned int sdev_fifo_used(struct simple_dev *dev)
+{
+    return smp_load_acquire(&dev->head) - smp_load_acquire(&dev->tail);
+}
+
+/**
+ * @brief Read from the FIFO ring
+ *
+ * Consumes up to @count bytes. The reader only ever advances the tail,
+ * so it never contends with a concurrent writer. Blocks while the FIFO
+ * is empty unless @nonblock is set.
+ *
+ * @param dev Device to read from
+ * @param to Destination iterator
+ * @param nonblock Return -EAGAIN instead of sleeping when empty
  * @return Number of bytes read, or negative error code
  */
-static ssize_t sdev_read(struct file *file, char __user *buf, 
-                         size_t count, loff_t *pos)
+static ssize_t sdev_fifo_read(struct simple_dev *dev, struct iov_iter *to,
+                              bool nonblock)
 {
-    struct simple_dev *dev = file->private_data;
+    size_t count = iov_iter_count(to);
+    unsigned int head, tail, off;
+    size_t first, copied;
     ssize_t ret = 0;
     
-    /* Acquire mutex to protect against concurrent access */
-    if (mutex_lock_interruptible(&dev->lock))
-        return -ERESTARTSYS;  /* Return if interrupted by signal */
+    if (!count)
+        return 0;
     
-    /* Check if we're at end of data */
-    if (*pos >= dev->size)
-        goto out;  /* Nothing more to read */
+    /* Only serialize against other readers */
+    if (sdev_mutex_lock(dev, &dev->read_lock))
+        return -ERESTARTSYS;
     
-    /* Adjust count if it would go past the end of data */
-    if (*pos + count > dev->size)
-        count = dev->size - *pos;
+    /* Sleep until a writer queues data, without holding the lock */
+    while (!sdev_fifo_used(dev)) {
+        mutex_unlock(&dev->read_lock);
+        if (nonblock)
+            return -EAGAIN;
+        if (wait_event_interruptible(dev->read_wq, sdev_fifo_used(dev)))
+            return -ERESTARTSYS;
+        if (sdev_mutex_lock(dev, &dev->read_lock))
+            return -ERESTARTSYS;
+    }
+    
+    /* Pairs with smp_store_release() of head in sdev_fifo_write() */
+    tail = dev->tail;
+    head = smp_load_acquire(&dev->head);
     
-    /* Copy data from kernel space to user space buffer */
-    if (copy_to_user(buf, dev->buffer + *pos, count)) {
+    /* Limit to the data currently queued */
+    count = min_t(size_t, count, head - tail);
+    
+    /* Copy out in at most two pieces when the data wraps around */
+    off = tail & (dev->capacity - 1);
+    first = min_t(size_t, count, dev->capacity - off);
+    copied = copy_to_iter(dev->ring + off, first, to);
+    if (copied == first && count > first)
+        copied += copy_to_iter(dev->ring, count - first, to);
+    if (!copied) {
         ret = -EFAULT;  /* Bad address error */
         goto out;
     }
     
-    /* Update position and return bytes read */
-    *pos += count;
-    ret = count;
+    /* Hand the space back to the writer only after the data is copied */
+    smp_store_release(&dev->tail, tail + copied);
+    sdev_wake(&dev->write_wq);
+    ret = copied;
     
 out:
-    /* Always release the mutex before returning */
-    mutex_unlock(&dev->lock);
+    mutex_unlock(&dev->read_lock);
     return ret;
 }
 
 /**
- * @brief Handler for device write() operation
+ * @brief Write to the FIFO ring
  *
- * Copies data from user space to our kernel buffer.
+ * Appends up to @count bytes. The writer only ever advances the head,
+ * so it never contends with a concurrent reader. Blocks while the FIFO
+ * is full unless @nonblock is set.
  *
- * @param file Pointer to file structure
- * @param buf User space buffer to copy data from
- * @param count Number of bytes to write
- * @param pos Current position in file
+ * @param dev Device to write to
+ * @param from Source iterator
+ * @param nonblock Return -EAGAIN instead of sleeping when full
  * @return Number of bytes written, or negative error code
  */
-static ssize_t sdev_write(struct file *file, const char __user *buf,
-                          size_t count, loff_t *pos)
+static ssize_t sdev_fifo_write(struct simple_dev *dev, struct iov_iter *from,
+                               bool nonblock)
+{
+    size_t count = iov_iter_count(from);
+    unsigned int head, tail, off;
+    size_t first, copied;
+    ssize_t ret;
+    
+    if (!count)
+        return 0;
+    
+    /* Only serialize against other writers */
+    if (sdev_mutex_lock(dev, &dev->write_lock))
+        return -ERESTARTSYS;
+    
+    /* Sleep until a reader frees space, without holding the lock */
+    while (sdev_fifo_used(dev) >= dev->capacity) {
+        mutex_unlock(&dev->write_lock);
+        if (nonblock)
+            return -EAGAIN;
+        if (wait_event_interruptible(dev->write_wq,
+                                     sdev_fifo_used(dev) < dev->capacity))
+            return -ERESTARTSYS;
+        if (sdev_mutex_lock(dev, &dev->write_lock))
+            return -ERESTARTSYS;
+    }
+    
+    /* Pairs with smp_store_release() of tail in sdev_fifo_read() */
+    head = dev->head;
+    tail = smp_load_acquire(&dev->tail);
+    
+    /* Limit to the free space in the ring */
+    count = min_t(size_t, count, dev->capacity - (head - tail));
+    
+    /* Copy in at most two pieces when the free space wraps around */
+    off = head & (dev->capacity - 1);
+    first = min_t(size_t, count, dev->capacity - off);
+    copied = copy_from_iter(dev->ring + off, first, from);
+    if (copied == first && count > first)
+        copied += copy_from_iter(dev->ring, count - first, from);
+    if (!copied) {
+        ret = -EFAULT;  /* Bad address error */
+        goto out;
+    }
+    
+    /* Publish the data to the reader only after it is fully copied */
+    smp_store_release(&dev->head, head + copied);
+    sdev_wake(&dev->read_wq);
+    ret = copied;
+    
+out:
+    mutex_unlock(&dev->write_lock);
+    return ret;
+}
+
+/**
+ * @brief Get the page backing a buffer page index
+ *
+ * Pages are only allocated the first time they are needed, so a large
+ * capacity costs nothing until it is written. Concurrent callers racing
+ * to allocate the same index agree on a single page via xa_cmpxchg().
+ *
+ * @param dev Device owning the pages
+ * @param index Page index within the buffer
+ * @return The page, or ERR_PTR(-ENOMEM) if it could not be allocated
+ */
+static struct page *sdev_get_page(struct simple_dev *dev, pgoff_t index)
+{
+    struct page *page, *old;
+    
+    page = xa_load(&dev->pages, index);
+    if (page)
+        return page;
+    
+    page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+    if (!page)
+        return ERR_PTR(-ENOMEM);
+    
+    /* Install the page unless someone else got there first */
+    old = xa_cmpxchg(&dev->pages, index, NULL, page, GFP_KERNEL);
+    if (old) {
+        __free_page(page);
+        return xa_is_err(old) ? ERR_PTR(xa_err(old)) : old;
+    }
+    return page;
+}
+
+/**
+ * @brief Release all buffer pages
+ *
+ * @param dev Device owning the pages
+ */
+static void sdev_free_pages(struct simple_dev *dev)
+{
+    struct page *page;
+    unsigned long index;
+    
+    xa_for_each(&dev->pages, index, page)
+        put_page(page);
+    xa_destroy(&dev->pages);
+}
+
+/**
+ * @brief Copy buffer contents to an iterator
+ *
+ * Works for any iterator type (user buffers, iovecs, pipe pages).
+ * Holes (pages that were never written) read back as zeros.
+ *
+ * @param dev Device to read from
+ * @param to Destination iterator
+ * @param count Number of bytes to copy
+ * @param pos Byte offset within the buffer
+ * @return Number of bytes copied, or -EFAULT if nothing could be copied
+ */
+static ssize_t sdev_copy_to_iter(struct simple_dev *dev, struct iov_iter *to,
+                                 size_t count, loff_t pos)
+{
+    size_t done = 0, off, n, copied;
+    struct page *page;
+    
+    while (done < count) {
+        off = offset_in_page(pos + done);
+        n = min_t(size_t, count - done, PAGE_SIZE - off);
+        page = xa_load(&dev->pages, (pos + done) >> PAGE_SHIFT);
+        if (page)
+            copied = copy_to_iter(page_address(page) + off, n, to);
+        else
+            copied = iov_iter_zero(n, to);
+        done += copied;
+        if (copied < n)
+            return done ? done : -EFAULT;  /* Bad address error */
+    }
+    
+    return done;
+}
+
+/**
+ * @brief Copy data from an iterator into the buffer
+ *
+ * Allocates the backing pages as needed.
+ *
+ * @param dev Device to write to
+ * @param from Source iterator
+ * @param count Number of bytes to copy
+ * @param pos Byte offset within the buffer
+ * @return Number of bytes copied, or negative error code if nothing
+ *         could be copied
+ */
+static ssize_t sdev_copy_from_iter(struct simple_dev *dev,
+                                   struct iov_iter *from,
+                                   size_t count, loff_t pos)
+{
+    size_t done = 0, off, n, copied;
+    struct page *page;
+    
+    while (done < count) {
+        off = offset_in_page(pos + done);
+        n = min_t(size_t, count - done, PAGE_SIZE - off);
+        page = sdev_get_page(dev, (pos + done) >> PAGE_SHIFT);
+        if (IS_ERR(page))
+            return done ? done : PTR_ERR(page);
+        copied = copy_from_iter(page_address(page) + off, n, from);
+        done += copied;
+        if (copied < n)
+            return done ? done : -EFAULT;  /* Bad address error */
+    }
+    
+    return done;
+}
+
+/**
+ * @brief Check whether an I/O request must not sleep
+ *
+ * @param iocb I/O control block of the request
+ * @return true for O_NONBLOCK files and RWF_NOWAIT requests
+ */
+static inline bool sdev_nonblock(struct kiocb *iocb)
+{
+    return (iocb->ki_filp->f_flags & O_NONBLOCK) ||
+           (iocb->ki_flags & IOCB_NOWAIT);
+}
+
+/**
+ * @brief Find the next data or hole offset for SEEK_DATA/SEEK_HOLE
+ *
+ * Pages that were never written are holes. The end of the data counts
+ * as a hole, as for regular files.
+ *
+ * @param dev Device to inspect (lock held)
+ * @param offset Starting offset, must be below dev->size
+ * @param whence SEEK_DATA or SEEK_HOLE
+ * @return The resulting offset, or -ENXIO if there is no more data
+ */
+static loff_t sdev_seek_data_hole(struct simple_dev *dev, loff_t offset,
+                                  int whence)
+{
+    unsigned long index = offset >> PAGE_SHIFT;
+    unsigned long last = (dev->size - 1) >> PAGE_SHIFT;
+    
+    if (whence == SEEK_DATA) {
+        /* First allocated page at or after the offset */
+        if (!xa_find(&dev->pages, &index, last, XA_PRESENT))
+            return -ENXIO;
+        return max_t(loff_t, offset, (loff_t)index << PAGE_SHIFT);
+    }
+    
+    /* SEEK_HOLE: first unallocated page at or after the offset */
+    while (index <= last && xa_load(&dev->pages, index))
+        index++;
+    if (index > last)
+        return dev->size;
+    return max_t(loff_t, offset, (loff_t)index << PAGE_SHIFT);
+}
+
+/**
+ * @brief Handler for device lseek() operation
+ *
+ * Supports SEEK_SET, SEEK_CUR and SEEK_END (relative to the valid data)
+ * anywhere within the buffer capacity, plus SEEK_DATA and SEEK_HOLE to
+ * skip over pages that were never written. Together with pread() and
+ * pwrite() this gives random access without reopening the device.
+ *
+ * @param file Pointer to file structure
+ * @param offset Requested offset
+ * @param whence SEEK_* mode
+ * @return The new file position, or negative error code
+ */
+static loff_t sdev_llseek(struct file *file, loff_t offset, int whence)
 {
     struct simple_dev *dev = file->private_data;
-    ssize_t ret = 0;
+    loff_t ret;
+    
+    /* A FIFO has no position */
+    if (dev->fifo)
+        return -ESPIPE;
+    
+    if (whence != SEEK_DATA && whence != SEEK_HOLE)
+        return generic_file_llseek_size(file, offset, whence, dev->capacity,
+                                        READ_ONCE(dev->size));
+    
+    /* Keep the size and page array stable while scanning */
+    if (sdev_down_read(dev))
+        return -ERESTARTSYS;
     
-    /* Acquire mutex to protect against concurrent access */
-    if (mutex_lock_interruptible(&dev->lock))
+    if (offset < 0 || offset >= dev->size)
+        ret = -ENXIO;  /* No data at or after this offset */
+    else
+        ret = sdev_seek_data_hole(dev, offset, whence);
+    
+    up_read(&dev->lock);
+    
+    if (ret < 0)
+        return ret;
+    return vfs_setpos(file, ret, dev->capacity);
+}
+
+/**
+ * @brief Read from the device
+ *
+ * Copies data from our kernel buffer to the destination iterator. When
+ * the file position has caught up with the data, blocks until a writer
+ * extends it (or returns -EAGAIN for non-blocking requests).
+ *
+ * @param iocb I/O control block holding the file and position
+ * @param to Destination iterator
+ * @return Number of bytes read, or negative error code
+ */
+static ssize_t sdev_do_read(struct kiocb *iocb, struct iov_iter *to)
+{
+    struct simple_dev *dev = iocb->ki_filp->private_data;
+    size_t count = iov_iter_count(to);
+    loff_t *pos = &iocb->ki_pos;
+    ssize_t ret;
+    
+    if (dev->fifo)
+        return sdev_fifo_read(dev, to, sdev_nonblock(iocb));
+    
+    /* Nothing can ever be read past the end of the buffer */
+    if (*pos >= dev->capacity || !count)
+        return 0;
+    
+    /* Readers only need shared access, so they run in parallel */
+    if (sdev_down_read(dev))
         return -ERESTARTSYS;  /* Return if interrupted by signal */
     
+    /* Wait for a writer to extend the data past our position */
+    while (*pos >= dev->size) {
+        up_read(&dev->lock);
+        if (sdev_nonblock(iocb))
+            return -EAGAIN;  /* No data yet, try again later */
+        if (wait_event_interruptible(dev->read_wq,
+                                     *pos < READ_ONCE(dev->size)))
+            return -ERESTARTSYS;
+        if (sdev_down_read(dev))
+            return -ERESTARTSYS;
+    }
+    
+    /* Adjust count if it would go past the end of data */
+    if (*pos + count > dev->size)
+        count = dev->size - *pos;
+    
+    /* Copy data from the buffer pages to the caller */
+    ret = sdev_copy_to_iter(dev, to, count, *pos);
+    
+    /* Update position and return bytes read */
+    if (ret > 0)
+        *pos += ret;
+    
+    /* Always release the lock before returning */
+    up_read(&dev->lock);
+    return ret;
+}
+
+/**
+ * @brief Write to the device
+ *
+ * Copies data from the source iterator to our kernel buffer.
+ *
+ * @param iocb I/O control block holding the file and position
+ * @param from Source iterator
+ * @return Number of bytes written, or negative error code
+ */
+static ssize_t sdev_do_write(struct kiocb *iocb, struct iov_iter *from)
+{
+    struct simple_dev *dev = iocb->ki_filp->private_data;
+    size_t count = iov_iter_count(from);
+    loff_t *pos = &iocb->ki_pos;
+    ssize_t ret;
+    
+    if (dev->fifo)
+        return sdev_fifo_write(dev, from, sdev_nonblock(iocb));
+    
+    /* Writers need exclusive access to keep size and data consistent */
+    if (sdev_down_write(dev))
+        return -ERESTARTSYS;  /* Return if killed */
+    
     /* Check if we're at end of buffer */
-    if (*pos >= BUFFER_SIZE) {
+    if (*pos >= dev->capacity) {
         ret = -ENOSPC;  /* No space left on device */
         goto out;
     }
     
     /* Adjust count if it would exceed buffer size */
-    if (*pos + count > BUFFER_SIZE)
-        count = BUFFER_SIZE - *pos;
+    if (*pos + count > dev->capacity)
+        count = dev->capacity - *pos;
     
-    /* Copy data from user space buffer to kernel space */
-    if (copy_from_user(dev->buffer + *pos, buf, count)) {
-        ret = -EFAULT;  /* Bad address error */
+    /* Copy data from the caller into the buffer pages */
+    ret = sdev_copy_from_iter(dev, from, count, *pos);
+    if (ret < 0)
         goto out;
-    }
     
     /* Update position, data size, and return bytes written */
-    *pos += count;
-    if (*pos > dev->size)
-        dev->size = *pos;
-    ret = count;
+    *pos += ret;
+    if (*pos > dev->size) {
+        WRITE_ONCE(dev->size, *pos);
+        sdev_wake(&dev->read_wq);  /* New data for blocked readers */
+    }
     
 out:
-    /* Always release the mutex before returning */
-    mutex_unlock(&dev->lock);
+    /* Always release the lock before returning */
+    up_write(&dev->lock);
+    return ret;
+}
+
+/**
+ * @brief Handler for device read(), readv() and splice-from operations
+ *
+ * Performs the read, updates the statistics and reports it to the
+ * simple_dev_read tracepoint.
+ *
+ * @param iocb I/O control block holding the file and position
+ * @param to Destination iterator
+ * @return Number of bytes read, or negative error code
+ */
+static ssize_t sdev_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    size_t count = iov_iter_count(to);
+    loff_t pos = iocb->ki_pos;
+    u64 start = 0;
+    ssize_t ret;
+    
+    if (trace_simple_dev_read_enabled())
+        start = ktime_get_ns();
+    
+    ret = sdev_do_read(iocb, to);
+    sdev_stats_account(iocb->ki_filp->private_data, false, ret);
+    
+    if (start)
+        trace_simple_dev_read(file_inode(iocb->ki_filp)->i_rdev, pos, count,
+                              ret, ktime_get_ns() - start);
     return ret;
 }
 
+/**
+ * @brief Handler for device write(), writev() and splice-to operations
+ *
+ * Performs the write, updates the statistics and reports it to the
+ * simple_dev_write tracepoint.
+ *
+ * @param iocb I/O control block holding the file and position
+ * @param from Source iterator
+ * @return Number of bytes written, or negative error code
+ */
+static ssize_t sdev_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    size_t count = iov_iter_count(from);
+    loff_t pos = iocb->ki_pos;
+    u64 start = 0;
+    ssize_t ret;
+    
+    if (trace_simple_dev_write_enabled())
+        start = ktime_get_ns();
+    
+    ret = sdev_do_write(iocb, from);
+    sdev_stats_account(iocb->ki_filp->private_data, true, ret);
+    
+    if (start)
+        trace_simple_dev_write(file_inode(iocb->ki_filp)->i_rdev, pos, count,
+                               ret, ktime_get_ns() - start);
+    return ret;
+}
+
+/**
+ * @brief Page fault handler for mmap() of the buffer
+ *
+ * Inserts the buffer page for the faulting offset, allocating it on
+ * first touch, so only pages the process actually uses are committed.
+ *
+ * @param vmf Fault descriptor
+ * @return 0 with vmf->page set, or VM_FAULT_* error
+ */
+static vm_fault_t sdev_vm_fault(struct vm_fault *vmf)
+{
+    struct simple_dev *dev = vmf->vma->vm_private_data;
+    struct page *page;
+    
+    if (vmf->pgoff >= dev->capacity >> PAGE_SHIFT)
+        return VM_FAULT_SIGBUS;
+    
+    page = sdev_get_page(dev, vmf->pgoff);
+    if (IS_ERR(page))
+        return vmf_error(PTR_ERR(page));
+    
+    /* The mapping holds its own reference to the page */
+    get_page(page);
+    vmf->page = page;
+    return 0;
+}
+
+/* VM operations for buffer mappings */
+static const struct vm_operations_struct sdev_vm_ops = {
+    .fault = sdev_vm_fault,
+};
+
+/**
+ * @brief Handler for device mmap() operation
+ *
+ * Maps the device buffer directly into the caller's address space so
+ * data can be produced and consumed without copy_to/from_user. Pages
+ * are faulted in on demand and the mapping may not extend past the
+ * buffer capacity; only shared mappings are accepted. Writers that fill
+ * the buffer through the mapping publish the valid length with
+ * SDEV_IOC_SET_SIZE.
+ *
+ * @param file Pointer to file structure
+ * @param vma Virtual memory area describing the requested mapping
+ * @return 0 on success, or negative error code
+ */
+static int sdev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    struct simple_dev *dev = file->private_data;
+    
+    /* The FIFO ring indices are not shared, so it cannot be mapped */
+    if (dev->fifo)
+        return -ENODEV;
+    
+    /* The mapping must lie within the buffer capacity */
+    if (vma->vm_pgoff + vma_pages(vma) > dev->capacity >> PAGE_SHIFT)
+        return -EINVAL;
+    
+    /* A private mapping gets copy-on-write pages that never reach the buffer */
+    if (!(vma->vm_flags & VM_SHARED))
+        return -EINVAL;
+    
+    /* Keep the mapping fixed in size and out of core dumps */
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+    vma->vm_ops = &sdev_vm_ops;
+    vma->vm_private_data = dev;
+    
+    return 0;
+}
+
+/**
+ * @brief Zero a range of the buffer
+ *
+ * Pages that were never written are already zero and stay unallocated.
+ *
+ * @param dev Device to modify (lock held for writing)
+ * @param pos Byte offset within the buffer
+ * @param count Number of bytes to zero
+ */
+static void sdev_clear(struct simple_dev *dev, loff_t pos, size_t count)
+{
+    size_t done = 0, off, n;
+    struct page *page;
+    
+    while (done < count) {
+        off = offset_in_page(pos + done);
+        n = min_t(size_t, count - done, PAGE_SIZE - off);
+        page = xa_load(&dev->pages, (pos + done) >> PAGE_SHIFT);
+        if (page)
+            memset(page_address(page) + off, 0, n);
+        done += n;
+    }
+}
+
+/**
+ * @brief Execute one entry of an SDEV_IOC_BATCH request
+ *
+ * Reads are limited to the valid data and writes to the capacity, just
+ * like read() and write(); unlike them, the position is explicit.
+ *
+ * @param dev Device to operate on (lock held)
+ * @param op Descriptor to execute
+ * @return Bytes transferred, the size for SDEV_OP_QUERY_SIZE, or
+ *         negative error code
+ */
+static __s64 sdev_batch_one(struct simple_dev *dev, const struct sdev_batch_op *op)
+{
+    void __user *addr = u64_to_user_ptr(op->addr);
+    struct iov_iter iter;
+    size_t len = op->len;
+    ssize_t ret;
+    
+    switch (op->op) {
+    case SDEV_OP_QUERY_SIZE:
+        return dev->size;
+    
+    case SDEV_OP_READ:
+        if (op->offset >= dev->size)
+            return 0;  /* Nothing to read */
+        len = min_t(u64, len, dev->size - op->offset);
+        ret = import_ubuf(ITER_DEST, addr, len, &iter);
+        if (ret)
+            return ret;
+        return sdev_copy_to_iter(dev, &iter, len, op->offset);
+    
+    case SDEV_OP_WRITE:
+        if (op->offset >= dev->capacity)
+            return -ENOSPC;  /* No space left on device */
+        len = min_t(u64, len, dev->capacity - op->offset);
+        ret = import_ubuf(ITER_SOURCE, addr, len, &iter);
+        if (ret)
+            return ret;
+        ret = sdev_copy_from_iter(dev, &iter, len, op->offset);
+        if (ret > 0 && op->offset + ret > dev->size)
+            WRITE_ONCE(dev->size, op->offset + ret);
+        return ret;
+    
+    case SDEV_OP_CLEAR:
+        if (op->offset >= dev->capacity)
+            return -EINVAL;
+        len = min_t(u64, len, dev->capacity - op->offset);
+        sdev_clear(dev, op->offset, len);
+        return len;
+    
+    default:
+        return -EINVAL;  /* Unknown operation */
+    }
+}
+
+/**
+ * @brief Handle SDEV_IOC_BATCH
+ *
+ * Copies in a vector of descriptors, runs all of them under a single
+ * lock acquisition (shared if the batch only reads, exclusive if it
+ * modifies the buffer) and writes the per-entry results back.
+ *
+ * @param dev Device to operate on
+ * @param ubatch User space batch header
+ * @return 0 if the batch was executed, or negative error code
+ */
+static long sdev_ioctl_batch(struct simple_dev *dev,
+                             struct sdev_batch __user *ubatch)
+{
+    struct sdev_batch batch;
+    struct sdev_batch_op *ops;
+    bool modify = false;
+    size_t old_size;
+    unsigned int i;
+    long ret = 0;
+    
+    if (copy_from_user(&batch, ubatch, sizeof(batch)))
+        return -EFAULT;
+    if (dev->fifo || batch.flags || !batch.count || batch.count > SDEV_BATCH_MAX)
+        return -EINVAL;
+    
+    /* Copy the whole descriptor vector in one go */
+    ops = memdup_user(u64_to_user_ptr(batch.ops),
+                      array_size(batch.count, sizeof(*ops)));
+    if (IS_ERR(ops))
+        return PTR_ERR(ops);
+    
+    for (i = 0; i < batch.count; i++)
+        if (ops[i].op == SDEV_OP_WRITE || ops[i].op == SDEV_OP_CLEAR)
+            modify = true;
+    
+    /* Take the lock once for the whole batch */
+    if (modify ? sdev_down_write(dev) :
+                 sdev_down_read(dev)) {
+        ret = -ERESTARTSYS;
+        goto out;
+    }
+    
+    old_size = dev->size;
+    for (i = 0; i < batch.count; i++)
+        ops[i].result = sdev_batch_one(dev, &ops[i]);
+    
+    if (modify)
+        up_write(&dev->lock);
+    else
+        up_read(&dev->lock);
+    
+    /* Wake blocked readers if the batch extended the data */
+    if (READ_ONCE(dev->size) > old_size)
+        sdev_wake(&dev->read_wq);
+    
+    /* Report the per-entry results */
+    if (copy_to_user(u64_to_user_ptr(batch.ops), ops,
+                     array_size(batch.count, sizeof(*ops))))
+        ret = -EFAULT;
+    
+out:
+    kfree(ops);
+    return ret;
+}
+
+/**
+ * @brief Handler for device ioctl() operation
+ *
+ * Lets user space query the buffer capacity and read or publish the
+ * number of valid bytes, which is needed when the buffer is filled
+ * through an mmap() mapping instead of write(). SDEV_IOC_BATCH runs a
+ * vector of operations under one lock acquisition.
+ *
+ * @param file Pointer to file structure
+ * @param cmd ioctl command number (SDEV_IOC_*)
+ * @param arg User space pointer to the command argument
+ * @return 0 on success, or negative error code
+ */
+static long sdev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    struct simple_dev *dev = file->private_data;
+    __u64 __user *uarg = (__u64 __user *)arg;
+    __u64 value;
+    long ret = 0;
+    
+    switch (cmd) {
+    case SDEV_IOC_GET_CAPACITY:
+        return put_user((__u64)dev->capacity, uarg);
+    
+    case SDEV_IOC_GET_SIZE:
+        /* In FIFO mode report the number of bytes queued */
+        if (dev->fifo) {
+            value = READ_ONCE(dev->head) - READ_ONCE(dev->tail);
+            return put_user(value, uarg);
+        }
+        /* A single word read needs no lock */
+        return put_user((__u64)READ_ONCE(dev->size), uarg);
+    
+    case SDEV_IOC_SET_SIZE:
+        if (get_user(value, uarg))
+            return -EFAULT;
+        if (dev->fifo || value > dev->capacity)
+            return -EINVAL;  /* Cannot publish more than the buffer holds */
+        if (sdev_down_write(dev))
+            return -ERESTARTSYS;
+        WRITE_ONCE(dev->size, value);
+        up_write(&dev->lock);
+        sdev_wake(&dev->read_wq);  /* Published data for blocked readers */
+        break;
+    
+    case SDEV_IOC_BATCH:
+        return sdev_ioctl_batch(dev, (struct sdev_batch __user *)arg);
+    
+    default:
+        ret = -ENOTTY;  /* Unknown command */
+        break;
+    }
+    
+    return ret;
+}
+
+/**
+ * @brief Handler for device poll() operation
+ *
+ * Reports readiness for poll(), select() and epoll(). In FIFO mode the
+ * device is readable while data is queued and writable while there is
+ * free space. In buffer mode it is readable while the file position is
+ * behind the data, and writes never block.
+ *
+ * @param file Pointer to file structure
+ * @param wait Poll table to register our wait queues with
+ * @return Mask of EPOLL* events that are ready
+ */
+static __poll_t sdev_poll(struct file *file, poll_table *wait)
+{
+    struct simple_dev *dev = file->private_data;
+    __poll_t mask = 0;
+    unsigned int used;
+    
+    poll_wait(file, &dev->read_wq, wait);
+    
+    if (dev->fifo) {
+        poll_wait(file, &dev->write_wq, wait);
+        used = sdev_fifo_used(dev);
+        if (used)
+            mask |= EPOLLIN | EPOLLRDNORM;
+        if (used < dev->capacity)
+            mask |= EPOLLOUT | EPOLLWRNORM;
+        return mask;
+    }
+    
+    /* Reads at or past the end of the buffer return EOF immediately */
+    if (file->f_pos < READ_ONCE(dev->size) || file->f_pos >= dev->capacity)
+        mask |= EPOLLIN | EPOLLRDNORM;
+    mask |= EPOLLOUT | EPOLLWRNORM;
+    
+    return mask;
+}
+
+/**
+ * @brief Initialize the locks, wait queues and page array of an instance
+ *
+ * @param dev Device to initialize
+ */
+static void sdev_init_state(struct simple_dev *dev)
+{
+    /* Initialize locks */
+    init_rwsem(&dev->lock);
+    mutex_init(&dev->read_lock);
+    mutex_init(&dev->write_lock);
+    
+    /* Initialize wait queues for blocking I/O and poll() */
+    init_waitqueue_head(&dev->read_wq);
+    init_waitqueue_head(&dev->write_wq);
+    
+    /* Buffer pages are allocated on demand as they are written */
+    xa_init(&dev->pages);
+}
+
+/**
+ * @brief Slab constructor for private instances
+ *
+ * Runs only when the slab allocator creates a new object, not on every
+ * allocation. Objects are returned to the cache in this constructed
+ * state, so reusing one on the next open() needs no re-initialization.
+ *
+ * @param obj Object being constructed
+ */
+static void sdev_priv_ctor(void *obj)
+{
+    struct simple_dev *dev = obj;
+    
+    memset(dev, 0, sizeof(*dev));
+    sdev_init_state(dev);
+    dev->priv = true;
+    dev->stats = sdev_priv_stats;
+}
+
+/**
+ * @brief Get a private instance for a new open file
+ *
+ * Private instances always use buffer mode, so they cost nothing until
+ * their pages are written.
+ *
+ * @return A ready-to-use instance, or NULL on allocation failure
+ */
+static struct simple_dev *sdev_priv_alloc(void)
+{
+    struct simple_dev *dev;
+    
+    dev = kmem_cache_alloc(sdev_priv_cache, GFP_KERNEL);
+    if (dev)
+        dev->capacity = capacity;
+    return dev;
+}
+
+/**
+ * @brief Return a private instance to the pool
+ *
+ * Frees the data pages and puts the instance back into the state the
+ * constructor left it in.
+ *
+ * @param dev Instance from sdev_priv_alloc()
+ */
+static void sdev_priv_free(struct simple_dev *dev)
+{
+    sdev_free_pages(dev);  /* Leaves the xarray empty and reusable */
+    dev->size = 0;
+    kmem_cache_free(sdev_priv_cache, dev);
+}
+
+/**
+ * @brief Create one device instance
+ *
+ * Allocates and initializes the per-minor state and registers the
+ * character device and its /dev/simple_devN file.
+ *
+ * @param minor Index of the instance, relative to sdev_base
+ * @return The new device, or ERR_PTR on failure
+ */
+static struct simple_dev *sdev_create(unsigned int minor)
+{
+    struct simple_dev *dev;
+    int ret;
+    
+    /* Allocate zeroed, cache-line aligned device structure */
+    dev = kmem_cache_zalloc(sdev_cache, GFP_KERNEL);
+    if (!dev)
+        return ERR_PTR(-ENOMEM);
+    
+    /* Initialize locks, wait queues and the (empty) page array */
+    sdev_init_state(dev);
+    dev->capacity = capacity;
+    dev->fifo = fifo_mode;
+    dev->dev_num = MKDEV(MAJOR(sdev_base), MINOR(sdev_base) + minor);
+    
+    /* Allocate per-CPU statistics */
+    dev->stats = alloc_percpu(struct sdev_stats);
+    if (!dev->stats) {
+        ret = -ENOMEM;  /* Out of memory error */
+        goto fail_stats;
+    }
+    
+    /* The FIFO ring is used all the time, so allocate it up front */
+    if (dev->fifo) {
+        dev->ring = kvzalloc(dev->capacity, GFP_KERNEL);
+        if (!dev->ring) {
+            ret = -ENOMEM;  /* Out of memory error */
+            goto fail_ring;
+        }
+    }
+    
+    /* Initialize character device structure with our file operations */
+    cdev_init(&dev->cdev, &simple_fops);
+    dev->cdev.owner = THIS_MODULE;
+    
+    /* Add character device to the system */
+    ret = cdev_add(&dev->cdev, dev->dev_num, 1);
+    if (ret < 0)
+        goto fail_cdev_add;
+    
+    /* Create a device file in /dev */
+    dev->device = device_create(sdev_class, NULL, dev->dev_num, dev,
+                                DRIVER_NAME "%u", minor);
+    if (IS_ERR(dev->device)) {
+        ret = PTR_ERR(dev->device);
+        goto fail_device_create;
+    }
+    
+    return dev;
+
+    /* Error handling with cleanup */
+fail_device_create:
+    cdev_del(&dev->cdev);
+fail_cdev_add:
+    kvfree(dev->ring);
+fail_ring:
+    free_percpu(dev->stats);
+fail_stats:
+    kmem_cache_free(sdev_cache, dev);
+    
+    return ERR_PTR(ret);
+}
+
+/**
+ * @brief Destroy one device instance
+ *
+ * @param dev Device created by sdev_create()
+ */
+static void sdev_destroy(struct simple_dev *dev)
+{
+    /* Remove device file and character device */
+    device_destroy(sdev_class, dev->dev_num);
+    cdev_del(&dev->cdev);
+    
+    /* Free the buffer pages, FIFO ring and statistics */
+    sdev_free_pages(dev);
+    kvfree(dev->ring);
+    free_percpu(dev->stats);
+    kmem_cache_free(sdev_cache, dev);
+}
+
+/**
+ * @brief Show the summed statistics of one device in debugfs
+ *
+ * @param m seq_file to print to; m->private holds the per-CPU counters
+ * @param unused Unused
+ * @return 0
+ */
+static int sdev_stats_show(struct seq_file *m, void *unused)
+{
+    struct sdev_stats __percpu *stats = m->private;
+    struct sdev_stats sum = {0};
+    const struct sdev_stats *st;
+    int cpu;
+    
+    /* Sum the per-CPU copies; values may be slightly stale */
+    for_each_possible_cpu(cpu) {
+        st = per_cpu_ptr(stats, cpu);
+        sum.read_ops += st->read_ops;
+        sum.write_ops += st->write_ops;
+        sum.read_bytes += st->read_bytes;
+        sum.write_bytes += st->write_bytes;
+        sum.efault += st->efault;
+        sum.erestartsys += st->erestartsys;
+        sum.lock_contended += st->lock_contended;
+        sum.lock_wait_ns += st->lock_wait_ns;
+    }
+    
+    seq_printf(m, "read_ops: %llu\n", sum.read_ops);
+    seq_printf(m, "write_ops: %llu\n", sum.write_ops);
+    seq_printf(m, "read_bytes: %llu\n", sum.read_bytes);
+    seq_printf(m, "write_bytes: %llu\n", sum.write_bytes);
+    seq_printf(m, "efault: %llu\n", sum.efault);
+    seq_printf(m, "erestartsys: %llu\n", sum.erestartsys);
+    seq_printf(m, "lock_contended: %llu\n", sum.lock_contended);
+    seq_printf(m, "lock_wait_ns: %llu\n", sum.lock_wait_ns);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(sdev_stats);
+
+/**
+ * @brief Zero all per-CPU copies of a set of counters
+ *
+ * @param stats Counters to reset
+ */
+static void sdev_stats_reset(struct sdev_stats __percpu *stats)
+{
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(stats, cpu), 0, sizeof(struct sdev_stats));
+}
+
+/**
+ * @brief Handler for writes to the debugfs reset file
+ *
+ * Any write resets the statistics of every device. The reset does not
+ * take dev->lock, so it never stalls I/O; a read or write finishing on
+ * another CPU at the same time may keep its count, which is harmless for
+ * these diagnostics.
+ *
+ * @param file Pointer to file structure
+ * @param buf User space buffer (ignored)
+ * @param count Number of bytes written
+ * @param pos Current position in file
+ * @return count
+ */
+static ssize_t sdev_reset_write(struct file *file, const char __user *buf,
+                                size_t count, loff_t *pos)
+{
+    unsigned int i;
+    
+    for (i = 0; i < nr_devs; i++)
+        sdev_stats_reset(sdev_devices[i]->stats);
+    sdev_stats_reset(sdev_priv_stats);
+    return count;
+}
+
+/* File operations for the debugfs reset file */
+static const struct file_operations sdev_reset_fops = {
+    .owner = THIS_MODULE,
+    .write = sdev_reset_write,
+};
+
+/**
+ * @brief Create the debugfs statistics files
+ *
+ * Creates /sys/kernel/debug/simple_driver/ with one stats file per
+ * device, one for all private instances, and a reset file. debugfs
+ * failures are not fatal for the driver.
+ */
+static void sdev_debugfs_init(void)
+{
+    char name[32];
+    unsigned int i;
+    
+    sdev_debugfs = debugfs_create_dir("simple_driver", NULL);
+    
+    for (i = 0; i < nr_devs; i++) {
+        snprintf(name, sizeof(name), DRIVER_NAME "%u", i);
+        debugfs_create_file(name, 0444, sdev_debugfs,
+                            sdev_devices[i]->stats, &sdev_stats_fops);
+    }
+    debugfs_create_file(PRIV_NAME, 0444, sdev_debugfs, sdev_priv_stats,
+                        &sdev_stats_fops);
+    debugfs_create_file("reset", 0200, sdev_debugfs, NULL, &sdev_reset_fops);
+}
+
 /**
  * @brief Initialize the module
  *
- * Called when the module is loaded. Sets up the device.
+ * Called when the module is loaded. Sets up all device instances.
  *
  * @return 0 on success, negative error code on failure
  */
 static int __init simple_init(void)
 {
+    unsigned int i;
     int ret;
     
-    /* Initialize device structure */
-    memset(&dev, 0, sizeof(struct simple_dev));
+    /* Validate the module parameters */
+    if (nr_devs < 1 || nr_devs > MAX_DEVS) {
+        pr_err("simple_driver: nr_devs must be between 1 and %d\n", MAX_DEVS);
+        return -EINVAL;
+    }
+    if (capacity < PAGE_SIZE || capacity > MAX_CAPACITY) {
+        pr_err("simple_driver: capacity must be between %lu and %lu bytes\n",
+               PAGE_SIZE, (unsigned long)MAX_CAPACITY);
+        return -EINVAL;
+    }
+    
+    /* FIFO mode masks free-running indices, so the ring size must be 2^n */
+    capacity = fifo_mode ? rounddown_pow_of_two(capacity) : PAGE_ALIGN(capacity);
     
-    /* Initialize mutex */
-    mutex_init(&dev.lock);
+    /* Create a cache-line aligned slab cache for device structures */
+    sdev_cache = KMEM_CACHE(simple_dev, SLAB_HWCACHE_ALIGN);
+    if (!sdev_cache) {
+        pr_err("simple_driver: Failed to create slab cache\n");
+        return -ENOMEM;  /* Out of memory error */
+    }
     
-    /* Allocate memory buffer for our device */
-    dev.buffer = kzalloc(BUFFER_SIZE, GFP_KERNEL);
-    if (!dev.buffer) {
+    /* Private instances all share one set of statistics */
+    sdev_priv_stats = alloc_percpu(struct sdev_stats);
+    if (!sdev_priv_stats) {
         pr_err("simple_driver: Failed to allocate memory\n");
-        return -ENOMEM;  /* Out of memory error */
+        ret = -ENOMEM;  /* Out of memory error */
+        goto fail_priv_stats;
+    }
+    
+    /* Create the pool of private instances handed out by /dev/simple_priv */
+    sdev_priv_cache = kmem_cache_create(PRIV_NAME, sizeof(struct simple_dev),
+                                        __alignof__(struct simple_dev),
+                                        SLAB_HWCACHE_ALIGN, sdev_priv_ctor);
+    if (!sdev_priv_cache) {
+        pr_err("simple_driver: Failed to create slab cache\n");
+        ret = -ENOMEM;  /* Out of memory error */
+        goto fail_priv_cache;
+    }
+    
+    /* Allocate the table of instances */
+    sdev_devices = kcalloc(nr_devs, sizeof(*sdev_devices), GFP_KERNEL);
+    if (!sdev_devices) {
+        pr_err("simple_driver: Failed to allocate memory\n");
+        ret = -ENOMEM;  /* Out of memory error */
+        goto fail_alloc_devices;
     }
     
-    /* Allocate a device number (major and minor) */
-    ret = alloc_chrdev_region(&dev.dev_num, 0, 1, DRIVER_NAME);
+    /* Allocate device numbers: nr_devs shared minors plus simple_priv */
+    ret = alloc_chrdev_region(&sdev_base, 0, nr_devs + 1, DRIVER_NAME);
     if (ret < 0) {
-        pr_err("simple_driver: Failed to allocate device number\n");
+        pr_err("simple_driver: Failed to allocate device numbers\n");
         goto fail_alloc_chrdev;
     }
     
     /* Create a device class */
-    dev.class = class_create(DRIVER_CLASS);
-    if (IS_ERR(dev.class)) {
+    sdev_class = class_create(DRIVER_CLASS);
+    if (IS_ERR(sdev_class)) {
         pr_err("simple_driver: Failed to create device class\n");
-        ret = PTR_ERR(dev.class);
+        ret = PTR_ERR(sdev_class);
         goto fail_class_create;
     }
     
-    /* Create a device file in /dev */
-    dev.device = device_create(dev.class, NULL, dev.dev_num, NULL, DRIVER_NAME);
-    if (IS_ERR(dev.device)) {
-        pr_err("simple_driver: Failed to create device file\n");
-        ret = PTR_ERR(dev.device);
-        goto fail_device_create;
+    /* Create each instance with its own buffer and locks */
+    for (i = 0; i < nr_devs; i++) {
+        sdev_devices[i] = sdev_create(i);
+        if (IS_ERR(sdev_devices[i])) {
+            pr_err("simple_driver: Failed to create %s%u\n", DRIVER_NAME, i);
+            ret = PTR_ERR(sdev_devices[i]);
+            goto fail_create;
+        }
     }
     
-    /* Initialize character device structure with our file operations */
-    cdev_init(&dev.cdev, &simple_fops);
-    dev.cdev.owner = THIS_MODULE;
-    
-    /* Add character device to the system */
-    ret = cdev_add(&dev.cdev, dev.dev_num, 1);
+    /* Create the private buffer device after the shared minors */
+    cdev_init(&sdev_priv_cdev, &simple_fops);
+    sdev_priv_cdev.owner = THIS_MODULE;
+    ret = cdev_add(&sdev_priv_cdev, sdev_base + nr_devs, 1);
     if (ret < 0) {
-        pr_err("simple_driver: Failed to add character device\n");
-        goto fail_cdev_add;
+        pr_err("simple_driver: Failed to add %s\n", PRIV_NAME);
+        goto fail_create;
+    }
+    sdev_priv_device = device_create(sdev_class, NULL, sdev_base + nr_devs,
+                                     NULL, PRIV_NAME);
+    if (IS_ERR(sdev_priv_device)) {
+        pr_err("simple_driver: Failed to create %s\n", PRIV_NAME);
+        ret = PTR_ERR(sdev_priv_device);
+        goto fail_priv_device;
     }
     
+    /* Export statistics */
+    sdev_debugfs_init();
+    
     /* Log successful initialization with device numbers */
-    pr_info("simple_driver: Initialized with major=%d, minor=%d\n",
-           MAJOR(dev.dev_num), MINOR(dev.dev_num));
+    pr_info("simple_driver: Initialized %u device(s) with major=%d (%s mode, %lu bytes each)\n",
+           nr_devs, MAJOR(sdev_base), fifo_mode ? "fifo" : "buffer", capacity);
     
     return 0;
 
     /* Error handling with cleanup */
-fail_cdev_add:
-    device_destroy(dev.class, dev.dev_num);
-fail_device_create:
-    class_destroy(dev.class);
+fail_priv_device:
+    cdev_del(&sdev_priv_cdev);
+fail_create:
+    while (i--)
+        sdev_destroy(sdev_devices[i]);
+    class_destroy(sdev_class);
 fail_class_create:
-    unregister_chrdev_region(dev.dev_num, 1);
+    unregister_chrdev_region(sdev_base, nr_devs + 1);
 fail_alloc_chrdev:
-    kfree(dev.buffer);
+    kfree(sdev_devices);
+fail_alloc_devices:
+    kmem_cache_destroy(sdev_priv_cache);
+fail_priv_cache:
+    free_percpu(sdev_priv_stats);
+fail_priv_stats:
+    kmem_cache_destroy(sdev_cache);
     
     return ret;
 }
@@ -273,20 +1564,30 @@ fail_alloc_chrdev:
  */
 static void __exit simple_exit(void)
 {
-    /* Remove character device from system */
-    cdev_del(&dev.cdev);
+    unsigned int i;
+    
+    /* Remove the statistics before the devices they point to */
+    debugfs_remove_recursive(sdev_debugfs);
+    
+    /* Remove the private buffer device */
+    device_destroy(sdev_class, sdev_base + nr_devs);
+    cdev_del(&sdev_priv_cdev);
     
-    /* Remove device file */
-    device_destroy(dev.class, dev.dev_num);
+    /* Remove every instance and free its memory */
+    for (i = 0; i < nr_devs; i++)
+        sdev_destroy(sdev_devices[i]);
+    kfree(sdev_devices);
     
     /* Remove device class */
-    class_destroy(dev.class);
+    class_destroy(sdev_class);
     
-    /* Release device number */
-    unregister_chrdev_region(dev.dev_num, 1);
+    /* Release device numbers */
+    unregister_chrdev_region(sdev_base, nr_devs + 1);
     
-    /* Free the memory buffer */
-    kfree(dev.buffer);
+    /* Destroy the slab caches once all instances are freed */
+    kmem_cache_destroy(sdev_priv_cache);
+    kmem_cache_destroy(sdev_cache);
+    free_percpu(sdev_priv_stats);
     
     /* Log successful unloading */
     pr_info("simple_driver: Module unloaded\n");
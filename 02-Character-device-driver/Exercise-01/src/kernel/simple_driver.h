@@ -0,0 +1,57 @@
+/**
+ * @file simple_driver.h
+ * @brief Definitions shared between simple_driver and user space
+ *
+ * This header only uses types from <linux/types.h> and <linux/ioctl.h>
+ * so it can be included by both the kernel module and test applications.
+ */
+
+#ifndef SIMPLE_DRIVER_H
+#define SIMPLE_DRIVER_H
+
+#include <linux/types.h>     /* For __u32, __u64, __s64 */
+#include <linux/ioctl.h>     /* For _IOR/_IOW */
+
+/* ioctl magic number for /dev/simple_dev */
+#define SDEV_IOC_MAGIC          's'
+
+/* Get the buffer capacity in bytes (largest valid mmap() length) */
+#define SDEV_IOC_GET_CAPACITY   _IOR(SDEV_IOC_MAGIC, 1, __u64)
+/* Get the number of valid bytes in the buffer */
+#define SDEV_IOC_GET_SIZE       _IOR(SDEV_IOC_MAGIC, 2, __u64)
+/* Publish the number of valid bytes after filling the buffer via mmap() */
+#define SDEV_IOC_SET_SIZE       _IOW(SDEV_IOC_MAGIC, 3, __u64)
+/* Execute a vector of operations under a single lock acquisition */
+#define SDEV_IOC_BATCH          _IOW(SDEV_IOC_MAGIC, 4, struct sdev_batch)
+
+/* Operations for struct sdev_batch_op */
+#define SDEV_OP_READ            0   /* Copy len bytes at offset to addr */
+#define SDEV_OP_WRITE           1   /* Copy len bytes from addr to offset */
+#define SDEV_OP_CLEAR           2   /* Zero len bytes at offset */
+#define SDEV_OP_QUERY_SIZE      3   /* Return the valid data size */
+
+/* Maximum number of entries in one SDEV_IOC_BATCH request */
+#define SDEV_BATCH_MAX          256
+
+/**
+ * One entry of an SDEV_IOC_BATCH request. READ stops at the end of the
+ * valid data and WRITE at the end of the buffer, like read()/write().
+ */
+struct sdev_batch_op {
+    __u64 offset;    /* Byte offset within the buffer */
+    __u64 addr;      /* User buffer for READ/WRITE */
+    __u32 len;       /* Number of bytes */
+    __u32 op;        /* SDEV_OP_* */
+    __s64 result;    /* Out: bytes transferred, size, or -errno */
+};
+
+/**
+ * Header of an SDEV_IOC_BATCH request. Only buffer mode supports batches.
+ */
+struct sdev_batch {
+    __u64 ops;       /* Pointer to an array of struct sdev_batch_op */
+    __u32 count;     /* Number of entries (1..SDEV_BATCH_MAX) */
+    __u32 flags;     /* Must be zero */
+};
+
+#endif /* SIMPLE_DRIVER_H */
@@ -0,0 +1,98 @@
+/**
+ * @file simple_driver_trace.h
+ * @brief Tracepoints for simple_driver
+ *
+ * Enable the events with ftrace or perf, for example:
+ *   echo 1 > /sys/kernel/tracing/events/simple_dev/enable
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM simple_dev
+
+#if !defined(_SIMPLE_DRIVER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _SIMPLE_DRIVER_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/kdev_t.h>
+
+/* open() and release() of a device file */
+DECLARE_EVENT_CLASS(simple_dev_file,
+    TP_PROTO(dev_t dev_num, bool priv),
+    TP_ARGS(dev_num, priv),
+
+    TP_STRUCT__entry(
+        __field(dev_t, dev_num)
+        __field(bool, priv)
+    ),
+
+    TP_fast_assign(
+        __entry->dev_num = dev_num;
+        __entry->priv = priv;
+    ),
+
+    TP_printk("dev=%d:%d priv=%d",
+              MAJOR(__entry->dev_num), MINOR(__entry->dev_num), __entry->priv)
+);
+
+DEFINE_EVENT(simple_dev_file, simple_dev_open,
+    TP_PROTO(dev_t dev_num, bool priv),
+    TP_ARGS(dev_num, priv)
+);
+
+DEFINE_EVENT(simple_dev_file, simple_dev_release,
+    TP_PROTO(dev_t dev_num, bool priv),
+    TP_ARGS(dev_num, priv)
+);
+
+/*
+ * Completed read or write, with its position, size, result and latency.
+ * The handlers only read the clock while the event is enabled, so a
+ * disabled event costs a single static branch per call.
+ */
+DECLARE_EVENT_CLASS(simple_dev_io,
+    TP_PROTO(dev_t dev_num, loff_t pos, size_t count, ssize_t ret,
+             u64 latency_ns),
+    TP_ARGS(dev_num, pos, count, ret, latency_ns),
+
+    TP_STRUCT__entry(
+        __field(dev_t, dev_num)
+        __field(loff_t, pos)
+        __field(size_t, count)
+        __field(ssize_t, ret)
+        __field(u64, latency_ns)
+    ),
+
+    TP_fast_assign(
+        __entry->dev_num = dev_num;
+        __entry->pos = pos;
+        __entry->count = count;
+        __entry->ret = ret;
+        __entry->latency_ns = latency_ns;
+    ),
+
+    TP_printk("dev=%d:%d pos=%lld count=%zu ret=%zd latency=%llu ns",
+              MAJOR(__entry->dev_num), MINOR(__entry->dev_num),
+              __entry->pos, __entry->count, __entry->ret,
+              __entry->latency_ns)
+);
+
+DEFINE_EVENT(simple_dev_io, simple_dev_read,
+    TP_PROTO(dev_t dev_num, loff_t pos, size_t count, ssize_t ret,
+             u64 latency_ns),
+    TP_ARGS(dev_num, pos, count, ret, latency_ns)
+);
+
+DEFINE_EVENT(simple_dev_io, simple_dev_write,
+    TP_PROTO(dev_t dev_num, loff_t pos, size_t count, ssize_t ret,
+             u64 latency_ns),
+    TP_ARGS(dev_num, pos, count, ret, latency_ns)
+);
+
+#endif /* _SIMPLE_DRIVER_TRACE_H */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE simple_driver_trace
+#include <trace/define_trace.h>
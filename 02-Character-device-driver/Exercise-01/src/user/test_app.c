@@ -6,20 +6,33 @@
  * - Open the character device
  * - Write data to the device
  * - Read data back from the device
+ * - Fill the buffer through mmap() and publish it with SDEV_IOC_SET_SIZE
+ * - Run a vector of operations with SDEV_IOC_BATCH
+ * - Find the data with SEEK_DATA/SEEK_HOLE
  * - Close the device
  */
 
+#define _GNU_SOURCE     /* For SEEK_DATA, SEEK_HOLE */
+
 #include <stdio.h>      /* For printf, perror */
 #include <stdlib.h>     /* For EXIT_SUCCESS, EXIT_FAILURE */
 #include <string.h>     /* For strlen */
-#include <unistd.h>     /* For close */
+#include <unistd.h>     /* For close, lseek */
 #include <fcntl.h>      /* For open, O_RDWR */
 #include <errno.h>      /* For errno */
+#include <stdint.h>     /* For uintptr_t */
 #include <sys/types.h>  /* For off_t */
+#include <sys/ioctl.h>  /* For ioctl */
+#include <sys/mman.h>   /* For mmap, munmap */
+
+#include "../kernel/simple_driver.h"  /* For SDEV_IOC_* */
 
 /* Constants */
-#define DEVICE_PATH     "/dev/simple_dev"   /* Path to the device file */
+#define DEVICE_PATH     "/dev/simple_dev0"  /* Path to the device file */
 #define BUFFER_SIZE     1024                /* Size of our read buffer */
+#define MMAP_MESSAGE    "Hello through mmap()!"  /* Written via the mapping */
+#define BATCH_MESSAGE   "Hello through a batch!" /* Written via SDEV_IOC_BATCH */
+#define BATCH_OFFSET    64                  /* Where the batch writes */
 
 /**
  * @brief Write a message to the device
@@ -83,10 +96,171 @@ static int read_device(int fd)
     return 0;
 }
 
+/**
+ * @brief Fill the buffer through mmap() and read it back with pread()
+ *
+ * Stores to the mapping go straight to the driver's pages; the data only
+ * becomes visible to read() once SDEV_IOC_SET_SIZE publishes its length.
+ *
+ * @param fd File descriptor of the opened device
+ * @return 0 on success, -1 on error
+ */
+static int test_mmap(int fd)
+{
+    size_t length = strlen(MMAP_MESSAGE);
+    char buffer[BUFFER_SIZE];
+    __u64 capacity, size;
+    ssize_t bytes;
+    char *map;
+    
+    printf("Testing mmap() and SDEV_IOC_SET_SIZE...\n");
+    
+    if (ioctl(fd, SDEV_IOC_GET_CAPACITY, &capacity) < 0) {
+        perror("Error getting capacity");
+        return -1;
+    }
+    
+    map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("Error mapping device");
+        return -1;
+    }
+    memcpy(map, MMAP_MESSAGE, length);
+    munmap(map, capacity);
+    
+    /* Publish the bytes stored through the mapping */
+    size = length;
+    if (ioctl(fd, SDEV_IOC_SET_SIZE, &size) < 0) {
+        perror("Error setting size");
+        return -1;
+    }
+    
+    /* Publishing more than the buffer holds must fail */
+    size = capacity + 1;
+    if (ioctl(fd, SDEV_IOC_SET_SIZE, &size) == 0 || errno != EINVAL) {
+        printf("SDEV_IOC_SET_SIZE beyond the capacity was not rejected\n");
+        return -1;
+    }
+    
+    bytes = pread(fd, buffer, sizeof(buffer), 0);
+    if (bytes != (ssize_t)length || memcmp(buffer, MMAP_MESSAGE, length) != 0) {
+        printf("pread() after mmap() returned %zd bytes, expected %zu\n", bytes, length);
+        return -1;
+    }
+    
+    printf("Read back %zd bytes written through mmap()\n", bytes);
+    return 0;
+}
+
+/**
+ * @brief Check one SDEV_IOC_BATCH result
+ *
+ * @param name Description of the entry
+ * @param result Result reported by the driver
+ * @param expected Expected result
+ * @return 0 if they match, -1 otherwise
+ */
+static int check_result(const char *name, __s64 result, __s64 expected)
+{
+    if (result != expected) {
+        printf("Batch %s: result %lld, expected %lld\n", name,
+               (long long)result, (long long)expected);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Run a batch that writes, reads elsewhere and queries the size
+ *
+ * Expects the buffer to hold MMAP_MESSAGE at offset 0. Also checks that
+ * a read running past the valid data is clipped.
+ *
+ * @param fd File descriptor of the opened device
+ * @return 0 on success, -1 on error
+ */
+static int test_batch(int fd)
+{
+    size_t length = strlen(BATCH_MESSAGE);
+    __s64 size = BATCH_OFFSET + length;
+    char head[8], tail[16];
+    struct sdev_batch_op ops[] = {
+        { .op = SDEV_OP_WRITE, .offset = BATCH_OFFSET,
+          .addr = (uintptr_t)BATCH_MESSAGE, .len = length },
+        { .op = SDEV_OP_READ, .offset = 0,
+          .addr = (uintptr_t)head, .len = sizeof(head) },
+        { .op = SDEV_OP_READ, .offset = size - 4,
+          .addr = (uintptr_t)tail, .len = sizeof(tail) },
+        { .op = SDEV_OP_QUERY_SIZE },
+    };
+    struct sdev_batch batch = {
+        .ops = (uintptr_t)ops,
+        .count = sizeof(ops) / sizeof(ops[0]),
+    };
+    int ret = 0;
+    
+    printf("Testing SDEV_IOC_BATCH...\n");
+    
+    if (ioctl(fd, SDEV_IOC_BATCH, &batch) < 0) {
+        perror("Error running batch");
+        return -1;
+    }
+    
+    ret |= check_result("write", ops[0].result, length);
+    ret |= check_result("read", ops[1].result, sizeof(head));
+    ret |= check_result("clipped read", ops[2].result, 4);
+    ret |= check_result("size", ops[3].result, size);
+    if (ret)
+        return -1;
+    
+    if (memcmp(head, MMAP_MESSAGE, sizeof(head)) != 0 ||
+        memcmp(tail, BATCH_MESSAGE + length - 4, 4) != 0) {
+        printf("Batch read returned the wrong data\n");
+        return -1;
+    }
+    
+    printf("Batch of %u operations succeeded\n", batch.count);
+    return 0;
+}
+
+/**
+ * @brief Find the data with SEEK_DATA and its end with SEEK_HOLE
+ *
+ * Expects the data left by test_batch(), which fits in the first page.
+ *
+ * @param fd File descriptor of the opened device
+ * @return 0 on success, -1 on error
+ */
+static int test_seek_data(int fd)
+{
+    off_t size = BATCH_OFFSET + strlen(BATCH_MESSAGE);
+    off_t data, hole;
+    
+    printf("Testing SEEK_DATA/SEEK_HOLE...\n");
+    
+    data = lseek(fd, 0, SEEK_DATA);
+    hole = lseek(fd, 0, SEEK_HOLE);
+    if (data != 0 || hole != size) {
+        printf("SEEK_DATA returned %lld and SEEK_HOLE %lld, expected 0 and %lld\n",
+               (long long)data, (long long)hole, (long long)size);
+        return -1;
+    }
+    
+    /* There is no data at or after the end */
+    if (lseek(fd, size, SEEK_DATA) != -1 || errno != ENXIO) {
+        printf("SEEK_DATA at the end did not fail with ENXIO\n");
+        return -1;
+    }
+    
+    printf("Data spans [%lld, %lld)\n", (long long)data, (long long)hole);
+    return 0;
+}
+
 /**
  * @brief Main function
  *
- * Opens the device, writes data to it, reads it back, then closes the device.
+ * Opens the device, writes data to it, rewinds, reads it back, exercises
+ * mmap(), SDEV_IOC_BATCH and SEEK_DATA/SEEK_HOLE, then closes the device.
  *
  * @param argc Number of command line arguments
  * @param argv Array of command line arguments
@@ -118,11 +292,10 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
     
-    /* Reopen the device to reset position */
-    close(fd);
-    fd = open(DEVICE_PATH, O_RDWR);
-    if (fd < 0) {
-        perror("Error reopening device");
+    /* Rewind to the start of the buffer */
+    if (lseek(fd, 0, SEEK_SET) < 0) {
+        perror("Error seeking device");
+        close(fd);
         return EXIT_FAILURE;
     }
     
@@ -132,6 +305,12 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
     
+    /* Exercise the zero-copy, batch and sparse-seek interfaces */
+    if (test_mmap(fd) < 0 || test_batch(fd) < 0 || test_seek_data(fd) < 0) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    
     /* Close the device */
     printf("Closing device\n");
     close(fd);
@@ -4,9 +4,27 @@
  * 
  * This driver implements direct maipulation of BCM2837 GPIO registers
  * to control LED. It creates a character device driver interface with basic read/write operation
+ *
+ * The set of pins is given by the "pins" module parameter. All of them are
+ * driven through a single mapping of the GPIO registers, and each one gets
+ * its own minor, /dev/gpio_led<N> where N is the BCM GPIO number.
+ * /dev/gpio_bank updates any number of them at once with set/clear masks
+ * and plays back uploaded waveforms from an hrtimer. A software PWM engine
+ * dims any number of pins from one shared hrtimer.
+ *
+ * Pins listed in "input_pins" are configured as inputs with edge detection.
+ * Their edges are queued with timestamps from the GPIO interrupt and read
+ * from /dev/gpio_in<N>.
+ *
+ * With queued=1, LED writes are pushed onto a lock-free list and applied
+ * by a worker that coalesces them; fsync() waits for them to complete.
+ *
+ * With backend=sim the registers are emulated in memory instead of being
+ * mapped, so the driver can be loaded and benchmarked on any machine.
  */
 
  #include <linux/module.h>  /* For MODULE_marcos */
+ #include <linux/moduleparam.h> /* For module_param_array */
  #include <linux/kernel.h>  /* For kernel logging functions */
  #include <linux/fs.h>      /* For file_operations, register_chrdev_region */
  #include <linux/cdev.h>    /* For character device functions */
@@ -15,266 +33,2497 @@
  #include <linux/slab.h>    /* For kmalloc, kfree */
  #include <linux/mutex.h>   /* For mutex operations */
  #include <linux/io.h>      /* For ioremap, iounmap */
+ #include <linux/ktime.h>   /* For ktime_get_ns */
+ #include <linux/percpu.h>  /* For per-CPU statistics */
+ #include <linux/debugfs.h> /* For debugfs files */
+ #include <linux/seq_file.h> /* For seq_printf */
+ #include <linux/bitops.h>  /* For hweight64 */
+ #include <linux/spinlock.h> /* For the register lock */
+ #include <linux/hrtimer.h> /* For the sequencer and PWM timers */
+ #include <linux/math64.h>  /* For div_u64 */
+ #include <linux/interrupt.h> /* For request_irq */
+ #include <linux/kfifo.h>   /* For the input event queues */
+ #include <linux/wait.h>    /* For wait queues */
+ #include <linux/poll.h>    /* For poll_wait */
+ #include <linux/jump_label.h> /* For the backend static key */
+ #include <linux/irq_work.h> /* For the simulated interrupt */
+ #include <linux/mm.h>      /* For io_remap_pfn_range */
+ #include <linux/capability.h> /* For CAP_SYS_RAWIO */
+ #include <linux/llist.h>   /* For the command queue */
+ #include <linux/workqueue.h> /* For the command worker */
+ #include <linux/string.h>  /* For vmemdup_user */
+ #include <linux/bitmap.h>  /* For bitmap_to_arr64 */
+ #include <linux/irq.h>     /* For the gpiolib irq_chip */
+ #include <linux/gpio/driver.h> /* For gpio_chip */
+ #include <linux/gpio/consumer.h> /* For gpiod_to_irq */
+
+ #include "gpio_led_driver.h" /* Shared ioctl definitions */
+
+ #define CREATE_TRACE_POINTS
+ #include "gpio_led_trace.h" /* Tracepoint definitions */
 
  /* Module information and constant */
  #define DRIVER_NAME     "gpio_led"         /* Device name in /dev/ */
  #define DRIVER_CLASS    "gpio_led_class"   /* Device class name */
- #define BUFFER_SIZE     PAGE_SIZE          /* Size of data buffer (4KB) */
+ #define BANK_NAME       "gpio_bank"        /* Bulk set/clear device in /dev/ */
+ #define IN_NAME         "gpio_in"          /* Input event devices in /dev/ */
+ #define IN_FIFO_SIZE    64                 /* Events queued per input (power of 2) */
+ #define BCM_GPIO_LABEL  "pinctrl-bcm2835"  /* gpio_chip providing the input IRQs */
+ #define BANK_BATCH      16                 /* Bank masks applied per lock acquisition */
+ #define CMD_QUEUE_MAX   256                /* Queued commands before writers wait */
 
  /* Raspberry Pi 3B+ GPIOO register (BCM2837) */
  #define BCM2837_GPIO_BASE     0x3F200000  /* Physical base address of GPIO */
  #define GPIO_REG_SIZE         0x1000      /* GPIO register area size (4KB) */
 
- /* GPIO pin for LED c */
- #define GPIO_LED_PIN          17          /* GPIO pin for LED (pin 17) */
+ /* GPIO pin for LED c */
+ #define GPIO_LED_PIN          17          /* Default GPIO pin for LED (pin 17) */
+ #define GPIO_MAX_PINS         54          /* BCM2837 has GPIO 0..53 */
+
+ /* Software PWM period limits */
+ #define PWM_PERIOD_MIN_US     1000        /* 1 kHz */
+ #define PWM_PERIOD_MAX_US     1000000     /* 1 Hz */
+
+ /* Register offsets */
+ #define GPFSEL0               0x00        /* GPIO Function Select 0 */
+ #define GPFSEL1               0x04        /* GPIO Function Select 1 */
+ #define GPFSEL2               0x08        /* GPIO Function Select 2 */
+ #define GPFSEL5               0x14        /* GPIO Function Select 5 */
+ #define GPSET0                0x1C        /* GPIO Pin Output Set 0 */
+ #define GPSET1                0x20        /* GPIO Pin Output Set 1 */
+ #define GPCLR0                0x28        /* GPIO Pin Output Clear 0 */
+ #define GPCLR1                0x2C        /* GPIO Pin Output Clear 1 */
+ #define GPLEV0                0x34        /* GPIO Pin Level 0 */
+ #define GPLEV1                0x38        /* GPIO Pin Level 1 */
+ #define GPEDS0                0x40        /* GPIO Pin Event Detect Status 0 */
+ #define GPEDS1                0x44        /* GPIO Pin Event Detect Status 1 */
+ #define GPREN0                0x4C        /* GPIO Pin Rising Edge Detect Enable 0 */
+ #define GPREN1                0x50        /* GPIO Pin Rising Edge Detect Enable 1 */
+ #define GPFEN0                0x58        /* GPIO Pin Falling Edge Detect Enable 0 */
+ #define GPFEN1                0x5C        /* GPIO Pin Falling Edge Detect Enable 1 */
+
+ /* Pins 0..31 live in the *0 registers, 32..53 in the *1 registers */
+ #define GPIO_BANK_OFFSET(gpio) (((gpio) / 32) * 4)
+ #define GPIO_BANK_BIT(gpio)    (1U << ((gpio) % 32))
+
+ /* GPIO function select values */
+ #define GPIO_FUNCTION_IN      GPIO_LED_FUNC_IN  /* Input */
+ #define GPIO_FUNCTION_OUT     GPIO_LED_FUNC_OUT /* Output */
+
+ /* Command values for LED control via write operation */
+ #define LED_CMD_ON    '1'     /* Turn LED on */
+ #define LED_CMD_OFF   '0'     /* Turn LED off */
+ #define LED_CMD_PWM   'p'     /* Set PWM duty, e.g. "p250" */
+
+ /**
+  * Memory-backed model of the GPIO registers used with backend=sim.
+  * Output pins read back their GPSET/GPCLR latch; input pins read the
+  * level injected through debugfs. Level changes latch edges in GPEDS
+  * as enabled by GPREN/GPFEN and raise a simulated interrupt.
+  */
+ struct gpio_led_sim {
+    raw_spinlock_t lock;       /* Serializes register accesses */
+    u32 fsel[6];               /* GPFSEL0..GPFSEL5 */
+    u64 out;                   /* Output latch written by GPSET/GPCLR */
+    u64 ext;                   /* Level driven onto input pins */
+    u64 ren;                   /* Rising edge detect enables */
+    u64 fen;                   /* Falling edge detect enables */
+    u64 eds;                   /* Latched edge events */
+    struct irq_work irq_work;  /* Delivers the simulated interrupt (hard IRQ) */
+    struct irq_work wake_work; /* Wakes input readers outside hard IRQ context */
+ };
+
+ /**
+  * Driver-wide counters for the file handlers, LED transitions, input
+  * edges and queued commands. Besides syscalls they are bumped from the
+  * PWM timer, the interrupt handlers and the queue worker, so each CPU
+  * updates its own copy with this_cpu ops and no lock is needed in any
+  * of those contexts; gpio_led_stats_show() sums the copies.
+  */
+ struct gpio_led_stats {
+    u64 reads;                 /* Completed read calls */
+    u64 writes;                /* Completed write calls */
+    u64 read_bytes;            /* Bytes returned by reads */
+    u64 write_bytes;           /* Bytes accepted by writes */
+    u64 led_on;                /* LED on transitions */
+    u64 led_off;               /* LED off transitions */
+    u64 efault;                /* Calls that failed with -EFAULT */
+    u64 erestartsys;           /* Calls interrupted by a signal */
+    u64 lock_contended;        /* Lock acquisitions that had to wait */
+    u64 lock_wait_ns;          /* Total time spent waiting for the lock */
+    u64 events;                /* Input edges queued */
+    u64 events_dropped;        /* Input edges lost to a full queue */
+    u64 cmds_queued;           /* Commands pushed in queued mode */
+    u64 cmds_coalesced;        /* Queued commands fully overridden by a later one */
+ };
+
+ /**
+  * LED update queued by a writer in queued mode
+  */
+ struct gpio_led_cmd {
+    struct llist_node node;    /* Entry in gpio_led_dev.cmd_list */
+    u64 set;                   /* Pins to drive high */
+    u64 clear;                 /* Pins to drive low */
+ };
+
+ /**
+  * One PWM period worth of edges. All PWM pins go high together at the
+  * start of the period; each edge then drives a group of pins with the
+  * same duty low. Edges are sorted by offset.
+  */
+ struct gpio_led_pwm_sched {
+    u64 set;                   /* Pins driven high at the period start */
+    unsigned int nr_edges;     /* Number of valid entries in edges */
+    struct {
+       u64 offset_ns;          /* Time from the period start */
+       u64 clear;              /* Pins driven low at this offset */
+    } edges[GPIO_MAX_PINS];
+ };
+
+ /**
+  * Per-pin state, one minor per managed pin
+  */
+ struct gpio_led_pin {
+    unsigned int gpio;         /* BCM GPIO number */
+    struct device *device;     /* Device structure for /dev/gpio_led<gpio> */
+ };
+
+ /**
+  * Per-input state, one minor per input pin. The pin's interrupt handler
+  * is the only producer of events and readers are serialized by read_lock, so
+  * the kfifo needs no further locking.
+  */
+ struct gpio_led_input {
+    unsigned int gpio;         /* BCM GPIO number */
+    struct device *device;     /* Device structure for /dev/gpio_in<gpio> */
+    int irq;                   /* Per-pin IRQ from the BCM GPIO controller */
+    DECLARE_KFIFO(events, struct gpio_led_event, IN_FIFO_SIZE); /* Pending edges */
+    wait_queue_head_t wq;      /* Readers waiting for events */
+    struct mutex read_lock;    /* Serializes consumers of events */
+ };
+
+ /**
+  * Device structure holding all driver state information
+  */
+ struct gpio_led_dev {
+    struct mutex seq_lock;     /* Serializes sequence upload and teardown */
+    dev_t dev_num;             /* First device number (major + minor) */
+    struct cdev cdev;          /* Character device covering all pins */
+    struct class *class;       /* Device class */
+    void __iomem *gpio_base;    /* Virtual address of GPIO registers */
+    struct gpio_led_pin *pins; /* Managed pins, indexed by minor */
+    unsigned int nr_pins;      /* Number of entries in pins */
+    u64 pin_mask;              /* Bit N set if GPIO N is managed */
+    raw_spinlock_t fsel_lock;  /* Protects fsel and GPFSEL writes */
+    u32 fsel[6];               /* Shadow copies of GPFSEL0..GPFSEL5 */
+    raw_spinlock_t hw_lock;    /* Serializes led_mask updates and GPSET/GPCLR writes */
+    u64 led_mask;              /* Current LED states, bit N for GPIO N; read locklessly */
+    struct hrtimer seq_timer;  /* Plays back the uploaded sequence */
+    struct gpio_led_step *seq_steps; /* Uploaded sequence, or NULL */
+    unsigned int seq_count;    /* Number of steps in seq_steps */
+    unsigned int seq_next;     /* Next step to apply */
+    bool seq_loop;             /* Restart after the last step */
+    struct hrtimer pwm_timer;  /* Single timer for all PWM pins */
+    u64 pwm_mask;              /* Pins currently under PWM control */
+    u16 pwm_duty[GPIO_MAX_PINS]; /* Duty per GPIO, per mille */
+    struct gpio_led_pwm_sched pwm_sched[2]; /* Current and pending schedule */
+    unsigned int pwm_cur;      /* Index of the schedule being played */
+    bool pwm_pending;          /* The other schedule is newer */
+    unsigned int pwm_edge;     /* 0 = period start, N = edges[N - 1] next */
+    bool pwm_running;          /* pwm_timer is armed */
+    struct gpio_led_input *inputs; /* Input pins, indexed by minor */
+    unsigned int nr_inputs;    /* Number of entries in inputs */
+    u64 in_mask;               /* Bit N set if GPIO N is an input */
+    u8 in_index[GPIO_MAX_PINS]; /* GPIO number to index in inputs */
+    dev_t in_dev_num;          /* First device number of the inputs */
+    struct cdev in_cdev;       /* Character device covering all inputs */
+    struct gpio_device *bcm_gpio; /* BCM GPIO controller, held while input IRQs exist */
+    struct gpio_chip chip;     /* gpiolib view of the managed pins */
+    u64 irq_enabled;           /* Inputs whose gpiolib IRQ is unmasked */
+    u64 irq_rise;              /* Inputs whose gpiolib IRQ wants rising edges */
+    u64 irq_fall;              /* Inputs whose gpiolib IRQ wants falling edges */
+    struct llist_head cmd_list; /* Queued commands, pushed by any writer */
+    struct work_struct cmd_work; /* Single consumer of cmd_list */
+    atomic_t cmd_depth;        /* Commands in cmd_list, at most CMD_QUEUE_MAX */
+    wait_queue_head_t cmd_wq;  /* Writers waiting for cmd_depth to drop */
+    struct cdev bank_cdev;     /* Character device for /dev/gpio_bank */
+    struct device *bank_device; /* Device structure for /dev/gpio_bank */
+    struct gpio_led_stats __percpu *stats; /* Operation counters */
+    struct dentry *debugfs;    /* debugfs directory with statistics */
+ };
+
+ /* Text returned by read() on /dev/gpio_led<N>, indexed by LED state */
+ static const char gpio_led_status[2][7] = { "LED=0\n", "LED=1\n" };
+
+ /* Global instance of our device */
+ static struct gpio_led_dev gpio_led_device = {0};
+
+ /* GPIO pins to drive, e.g. pins=17,18,27 */
+ static unsigned int pins[GPIO_MAX_PINS] = { GPIO_LED_PIN };
+ static int nr_pins = 1;
+ module_param_array(pins, uint, &nr_pins, 0444);
+ MODULE_PARM_DESC(pins, "Comma-separated BCM GPIO numbers to drive (default 17)");
+
+ /* GPIO pins to configure as inputs, e.g. input_pins=22,23 */
+ static unsigned int input_pins[GPIO_MAX_PINS];
+ static int nr_inputs;
+ module_param_array(input_pins, uint, &nr_inputs, 0444);
+ MODULE_PARM_DESC(input_pins, "Comma-separated BCM GPIO numbers to use as edge-detecting inputs");
+
+ /* Register backend: "hw" maps the BCM2837 registers, "sim" emulates them */
+ static char *backend = "hw";
+ module_param(backend, charp, 0444);
+ MODULE_PARM_DESC(backend, "Register backend: hw (default) or sim");
+
+ /* Enabled for backend=sim; keeps the hardware accessors branch-free */
+ static DEFINE_STATIC_KEY_FALSE(gpio_led_sim_key);
+ static struct gpio_led_sim gpio_led_sim;
+
+ /* Queue LED writes for a coalescing worker instead of applying them inline */
+ static bool queued;
+ module_param(queued, bool, 0444);
+ MODULE_PARM_DESC(queued, "Apply LED writes asynchronously from a coalescing worker (default 0)");
+
+ /* Allocator for queued commands */
+ static struct kmem_cache *gpio_led_cmd_cache;
+
+ /* Software PWM period shared by all pins */
+ static unsigned int pwm_period_us = 10000;
+ module_param(pwm_period_us, uint, 0444);
+ MODULE_PARM_DESC(pwm_period_us, "Software PWM period in microseconds (1000..1000000, default 10000)");
+
+ /* Forward declarations for file operations */
+ static int gpio_led_open(struct inode *inode, struct file *file);
+ static int gpio_led_release(struct inode *inode, struct file *file);
+ static ssize_t gpio_led_read(struct file *file, char __user *buf, size_t count, loff_t *pos);
+ static ssize_t gpio_led_write(struct file *file, const char __user *buf, size_t count, loff_t *pos);
+ static long gpio_led_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+ static int gpio_led_fsync(struct file *file, loff_t start, loff_t end, int datasync);
+ static ssize_t gpio_led_bank_read(struct file *file, char __user *buf, size_t count, loff_t *pos);
+ static ssize_t gpio_led_bank_write(struct file *file, const char __user *buf, size_t count, loff_t *pos);
+ static long gpio_led_bank_ioctl(struct file *file, unsigned int cmd, unsigned long arg);
+ static int gpio_led_bank_mmap(struct file *file, struct vm_area_struct *vma);
+ static int gpio_led_in_open(struct inode *inode, struct file *file);
+ static ssize_t gpio_led_in_read(struct file *file, char __user *buf, size_t count, loff_t *pos);
+ static __poll_t gpio_led_in_poll(struct file *file, poll_table *wait);
+ static irqreturn_t gpio_led_irq(int irq, void *data);
+
+/**
+ * File operation structure defining the driver's capabilities
+ */
+ static const struct file_operations gpio_led_fops = {
+    .owner = THIS_MODULE,           /* Module that owns this structure */
+    .open = gpio_led_open,          /* Called on open() */
+    .release = gpio_led_release,    /* Called on close() */
+    .read = gpio_led_read,          /* Called on read() */
+    .write = gpio_led_write,        /* Called on write() */
+    .unlocked_ioctl = gpio_led_ioctl, /* Called on ioctl() */
+    .compat_ioctl = compat_ptr_ioctl, /* 32-bit ioctl() on 64-bit kernel */
+    .fsync = gpio_led_fsync,        /* Called on fsync() */
+ };
+
+ /**
+  * File operation structure for /dev/gpio_bank
+  */
+ static const struct file_operations gpio_led_bank_fops = {
+    .owner = THIS_MODULE,                  /* Module that owns this structure */
+    .read = gpio_led_bank_read,            /* Called on read() */
+    .write = gpio_led_bank_write,          /* Called on write() */
+    .unlocked_ioctl = gpio_led_bank_ioctl, /* Called on ioctl() */
+    .compat_ioctl = compat_ptr_ioctl,      /* 32-bit ioctl() on 64-bit kernel */
+    .mmap = gpio_led_bank_mmap,            /* Called on mmap() */
+    .fsync = gpio_led_fsync,               /* Called on fsync() */
+ };
+
+ /**
+  * File operation structure for /dev/gpio_in<N>
+  */
+ static const struct file_operations gpio_led_in_fops = {
+    .owner = THIS_MODULE,           /* Module that owns this structure */
+    .open = gpio_led_in_open,       /* Called on open() */
+    .read = gpio_led_in_read,       /* Called on read() */
+    .poll = gpio_led_in_poll,       /* Called on poll()/select() */
+    .llseek = noop_llseek,          /* Events are a stream */
+ };
+
+ /**
+  * @brief Current pin levels of the simulated GPIO block
+  * 
+  * Must be called with the simulator lock held.
+  * 
+  * @return Levels, bit N for GPIO N
+  */
+ static u64 gpio_led_sim_level(void) {
+   struct gpio_led_sim *sim = &gpio_led_sim;
+   u64 outputs = 0;
+   unsigned int gpio;
+
+   for (gpio = 0; gpio < GPIO_MAX_PINS; gpio++) {
+      if (((sim->fsel[gpio / 10] >> ((gpio % 10) * 3)) & 7) == GPIO_FUNCTION_OUT)
+         outputs |= BIT_ULL(gpio);
+   }
+   return (sim->out & outputs) | (sim->ext & ~outputs);
+ }
+
+ /**
+  * @brief Latch edges caused by a register write and raise the interrupt
+  * 
+  * Must be called with the simulator lock held.
+  * 
+  * @param old Pin levels before the write
+  */
+ static void gpio_led_sim_edges(u64 old) {
+   struct gpio_led_sim *sim = &gpio_led_sim;
+   u64 now = gpio_led_sim_level();
+
+   sim->eds |= (~old & now & sim->ren) | (old & ~now & sim->fen);
+   if (sim->eds)
+      irq_work_queue(&sim->irq_work);
+ }
+
+ /**
+  * @brief Deliver the simulated GPIO interrupt
+  * 
+  * The irq_work is IRQ_WORK_HARD_IRQ, so the handler runs in hard
+  * interrupt context even on PREEMPT_RT, like a real GPIO interrupt
+  * delivered by the interrupt controller.
+  * 
+  * @param work The simulator irq_work
+  */
+ static void gpio_led_sim_irq(struct irq_work *work) {
+   gpio_led_irq(-1, &gpio_led_device);
+ }
+
+ /**
+  * @brief Wake readers of inputs with pending events
+  * 
+  * Wait queues use sleeping locks on PREEMPT_RT, so the hard IRQ
+  * simulated interrupt defers reader wakeups to this irq_work.
+  * 
+  * @param work The simulator wake_work
+  */
+ static void gpio_led_sim_wake(struct irq_work *work) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   unsigned int i;
+
+   for (i = 0; i < dev->nr_inputs; i++)
+      if (!kfifo_is_empty(&dev->inputs[i].events))
+         wake_up_interruptible_poll(&dev->inputs[i].wq, EPOLLIN | EPOLLRDNORM);
+ }
+
+ /**
+  * @brief Replace one 32-bit half of a 64-bit simulated register pair
+  * 
+  * @param reg Register pair, bit N for GPIO N
+  * @param bank 0 for the *0 register, 1 for the *1 register
+  * @param value New contents of that half
+  */
+ static void gpio_led_sim_set_half(u64 *reg, unsigned int bank, u32 value) {
+   if (bank)
+      *reg = ((u64)value << 32) | lower_32_bits(*reg);
+   else
+      *reg = (*reg & GENMASK_ULL(63, 32)) | value;
+ }
+
+ /**
+  * @brief Read a simulated register
+  * 
+  * @param offset Register offset from the GPIO base
+  * @return Register value; unmodelled registers read as zero
+  */
+ static u32 gpio_led_sim_readl(unsigned int offset) {
+   struct gpio_led_sim *sim = &gpio_led_sim;
+   unsigned long flags;
+   u64 value = 0;
+
+   raw_spin_lock_irqsave(&sim->lock, flags);
+   switch (offset) {
+    case GPFSEL0 ... GPFSEL5:
+        value = sim->fsel[offset / 4];
+        break;
+    case GPLEV0:
+    case GPLEV1:
+        value = gpio_led_sim_level() >> ((offset - GPLEV0) * 8);
+        break;
+    case GPEDS0:
+    case GPEDS1:
+        value = sim->eds >> ((offset - GPEDS0) * 8);
+        break;
+    case GPREN0:
+    case GPREN1:
+        value = sim->ren >> ((offset - GPREN0) * 8);
+        break;
+    case GPFEN0:
+    case GPFEN1:
+        value = sim->fen >> ((offset - GPFEN0) * 8);
+        break;
+   }
+   raw_spin_unlock_irqrestore(&sim->lock, flags);
+
+   return lower_32_bits(value);
+ }
+
+ /**
+  * @brief Write a simulated register
+  * 
+  * GPSET/GPCLR and GPEDS are write-one-to-act like the hardware; writes to
+  * unmodelled registers are ignored.
+  * 
+  * @param value Value to write
+  * @param offset Register offset from the GPIO base
+  */
+ static void gpio_led_sim_writel(u32 value, unsigned int offset) {
+   struct gpio_led_sim *sim = &gpio_led_sim;
+   unsigned long flags;
+   u64 old;
+
+   raw_spin_lock_irqsave(&sim->lock, flags);
+   old = gpio_led_sim_level();
+   switch (offset) {
+    case GPFSEL0 ... GPFSEL5:
+        sim->fsel[offset / 4] = value;
+        break;
+    case GPSET0:
+    case GPSET1:
+        sim->out |= (u64)value << ((offset - GPSET0) * 8);
+        break;
+    case GPCLR0:
+    case GPCLR1:
+        sim->out &= ~((u64)value << ((offset - GPCLR0) * 8));
+        break;
+    case GPEDS0:
+    case GPEDS1:
+        sim->eds &= ~((u64)value << ((offset - GPEDS0) * 8));
+        break;
+    case GPREN0:
+    case GPREN1:
+        gpio_led_sim_set_half(&sim->ren, (offset - GPREN0) / 4, value);
+        break;
+    case GPFEN0:
+    case GPFEN1:
+        gpio_led_sim_set_half(&sim->fen, (offset - GPFEN0) / 4, value);
+        break;
+   }
+   gpio_led_sim_edges(old);
+   raw_spin_unlock_irqrestore(&sim->lock, flags);
+ }
+
+ /**
+  * @brief Read a GPIO register from the selected backend
+  * 
+  * @param offset Register offset from the GPIO base
+  * @return Register value
+  */
+ static inline u32 gpio_led_readl(unsigned int offset) {
+   if (static_branch_unlikely(&gpio_led_sim_key))
+      return gpio_led_sim_readl(offset);
+   return readl(gpio_led_device.gpio_base + offset);
+ }
+
+ /**
+  * @brief Write a GPIO register of the selected backend
+  * 
+  * @param value Value to write
+  * @param offset Register offset from the GPIO base
+  */
+ static inline void gpio_led_writel(u32 value, unsigned int offset) {
+   if (static_branch_unlikely(&gpio_led_sim_key))
+      gpio_led_sim_writel(value, offset);
+   else
+      writel(value, gpio_led_device.gpio_base + offset);
+ }
+
+ /**
+  * @brief Load the GPFSEL shadow registers from the hardware
+  * 
+  * Called once at load. gpio_led_set_functions() refreshes the registers
+  * it touches, so the shadows never overwrite another driver's pinmux.
+  */
+ static void gpio_led_fsel_init(void) {
+   unsigned int reg;
+
+   for (reg = 0; reg < ARRAY_SIZE(gpio_led_device.fsel); reg++)
+      gpio_led_device.fsel[reg] = gpio_led_readl(GPFSEL0 + reg * 4);
+ }
+
+ /**
+  * @brief Change the function of many pins with one write per GPFSEL register
+  * 
+  * Each GPFSEL register also holds pins of other drivers (pinctrl may
+  * remux them at any time), so the shadow of every register about to be
+  * touched is first refreshed from the hardware. All changes are then
+  * computed on a copy of the shadows and each register that actually
+  * changed is written exactly once. fsel_lock makes the update atomic
+  * with respect to other configuration changes made by this driver.
+  * 
+  * @param masks masks[f] holds the pins to switch to function f, bit N for GPIO N
+  */
+ static void gpio_led_set_functions(const u64 masks[GPIO_LED_FUNC_COUNT]) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   u32 fsel[ARRAY_SIZE(dev->fsel)];
+   unsigned int function, gpio, reg, shift;
+   unsigned long flags, touched = 0;
+   u64 pending = 0;
+
+   for (function = 0; function < GPIO_LED_FUNC_COUNT; function++)
+      pending |= masks[function];
+   while (pending) {
+      gpio = __ffs64(pending);
+      pending &= pending - 1;
+      touched |= BIT(gpio / 10);
+   }
+
+   raw_spin_lock_irqsave(&dev->fsel_lock, flags);
+
+   /* Pick up pinmux changes made by other drivers since the last update */
+   for_each_set_bit(reg, &touched, ARRAY_SIZE(fsel))
+      dev->fsel[reg] = gpio_led_readl(GPFSEL0 + reg * 4);
+   memcpy(fsel, dev->fsel, sizeof(fsel));
+
+   for (function = 0; function < GPIO_LED_FUNC_COUNT; function++) {
+      pending = masks[function];
+      while (pending) {
+         gpio = __ffs64(pending);
+         pending &= pending - 1;
+
+         /* Ten pins per register, three bits per pin */
+         reg = gpio / 10;
+         shift = (gpio % 10) * 3;
+         fsel[reg] = (fsel[reg] & ~(7U << shift)) | (function << shift);
+      }
+   }
+
+   for (reg = 0; reg < ARRAY_SIZE(fsel); reg++) {
+      if (fsel[reg] == dev->fsel[reg])
+         continue;
+      gpio_led_writel(fsel[reg], GPFSEL0 + reg * 4);
+      dev->fsel[reg] = fsel[reg];
+   }
+   raw_spin_unlock_irqrestore(&dev->fsel_lock, flags);
+ }
+
+ /**
+  * @brief Validate and apply a GPIO_LED_IOC_SET_FUNCTIONS request
+  * 
+  * @param req Requested functions
+  * @return 0 on success, -EINVAL for unmanaged or repeated pins
+  */
+ static int gpio_led_apply_functions(const struct gpio_led_fsel *req) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   u64 seen = 0;
+   unsigned int function;
+
+   for (function = 0; function < GPIO_LED_FUNC_COUNT; function++) {
+      if (req->mask[function] & (seen | ~(dev->pin_mask | dev->in_mask)))
+         return -EINVAL;
+      seen |= req->mask[function];
+   }
+
+   gpio_led_set_functions(req->mask);
+   return 0;
+ }
+
+ /**
+  * @brief Write set/clear masks to the GPSET/GPCLR registers
+  * 
+  * All pins in one GPSET or GPCLR register change at the same instant.
+  * Set is written before clear; registers without any bit are skipped.
+  * 
+  * @param set Pins to drive high, bit N for GPIO N
+  * @param clear Pins to drive low, bit N for GPIO N
+  */
+ static void gpio_led_write_regs(u64 set, u64 clear) {
+   if (lower_32_bits(set))
+      gpio_led_writel(lower_32_bits(set), GPSET0);
+   if (upper_32_bits(set))
+      gpio_led_writel(upper_32_bits(set), GPSET1);
+   if (lower_32_bits(clear))
+      gpio_led_writel(lower_32_bits(clear), GPCLR0);
+   if (upper_32_bits(clear))
+      gpio_led_writel(upper_32_bits(clear), GPCLR1);
+ }
+
+ /**
+  * @brief Rebuild the PWM schedule from pwm_mask and pwm_duty
+  * 
+  * The new schedule is written to the slot not being played and picked up
+  * by the timer at the next period start, so running periods are never
+  * cut short. Arms the timer if it is idle. Must be called with hw_lock
+  * held.
+  */
+ static void gpio_led_pwm_build(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_led_pwm_sched *sched = &dev->pwm_sched[!dev->pwm_cur];
+   u64 period_ns = (u64)pwm_period_us * NSEC_PER_USEC;
+   unsigned int gpio, i, n = 0;
+   u64 offset;
+
+   sched->set = dev->pwm_mask;
+
+   for (gpio = 0; gpio < GPIO_MAX_PINS; gpio++) {
+      if (!(dev->pwm_mask & BIT_ULL(gpio)))
+         continue;
+
+      offset = div_u64(period_ns * dev->pwm_duty[gpio], GPIO_LED_PWM_MAX);
+
+      /* Insertion sort; pins with the same duty share one edge */
+      for (i = 0; i < n && sched->edges[i].offset_ns < offset; i++)
+         ;
+      if (i < n && sched->edges[i].offset_ns == offset) {
+         sched->edges[i].clear |= BIT_ULL(gpio);
+         continue;
+      }
+      memmove(&sched->edges[i + 1], &sched->edges[i], (n - i) * sizeof(sched->edges[0]));
+      sched->edges[i].offset_ns = offset;
+      sched->edges[i].clear = BIT_ULL(gpio);
+      n++;
+   }
+   sched->nr_edges = n;
+   dev->pwm_pending = true;
+
+   if (dev->pwm_mask && !dev->pwm_running) {
+      dev->pwm_running = true;
+      dev->pwm_edge = 0;
+      hrtimer_start(&dev->pwm_timer, 0, HRTIMER_MODE_REL_HARD);
+   }
+ }
+
+ /**
+  * @brief Take pins out of PWM mode before they are driven statically
+  * 
+  * Must be called with hw_lock held.
+  * 
+  * @param mask Pins about to be set or cleared
+  */
+ static void gpio_led_pwm_release(u64 mask) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+
+   if (!(dev->pwm_mask & mask))
+      return;
+
+   WRITE_ONCE(dev->pwm_mask, dev->pwm_mask & ~mask);
+   gpio_led_pwm_build();
+ }
+
+ /**
+  * @brief PWM timer callback, handles one period start or edge per expiry
+  * 
+  * Runs in hard interrupt context, also on PREEMPT_RT since the timer
+  * uses HRTIMER_MODE_REL_HARD, so hw_lock needs no irqsave here. Only
+  * pins still in pwm_mask are touched, so pins released in the middle
+  * of a period stop toggling at once. Expiries advance from the previous
+  * expiry to avoid drift.
+  * 
+  * @param timer The PWM timer
+  * @return HRTIMER_RESTART while any pin is in PWM mode
+  */
+ static enum hrtimer_restart gpio_led_pwm_fn(struct hrtimer *timer) {
+   struct gpio_led_dev *dev = container_of(timer, struct gpio_led_dev, pwm_timer);
+   u64 period_ns = (u64)pwm_period_us * NSEC_PER_USEC;
+   struct gpio_led_pwm_sched *sched;
+   u64 now, next;
+
+   raw_spin_lock(&dev->hw_lock);
+
+   /* Switch to a rebuilt schedule only at a period boundary */
+   if (dev->pwm_edge == 0 && dev->pwm_pending) {
+      dev->pwm_cur = !dev->pwm_cur;
+      dev->pwm_pending = false;
+   }
+   sched = &dev->pwm_sched[dev->pwm_cur];
+
+   if (dev->pwm_edge == 0) {
+      if (!sched->set) {
+         dev->pwm_running = false;
+         raw_spin_unlock(&dev->hw_lock);
+         return HRTIMER_NORESTART;
+      }
+      gpio_led_write_regs(sched->set & dev->pwm_mask, 0);
+      now = 0;
+   } else {
+      gpio_led_write_regs(0, sched->edges[dev->pwm_edge - 1].clear & dev->pwm_mask);
+      now = sched->edges[dev->pwm_edge - 1].offset_ns;
+   }
+
+   /* Step to the next edge, or back to the next period start */
+   if (dev->pwm_edge == sched->nr_edges) {
+      dev->pwm_edge = 0;
+      next = period_ns;
+   } else {
+      next = sched->edges[dev->pwm_edge].offset_ns;
+      dev->pwm_edge++;
+   }
+
+   raw_spin_unlock(&dev->hw_lock);
+
+   hrtimer_add_expires_ns(timer, next - now);
+   return HRTIMER_RESTART;
+ }
+
+ /**
+  * @brief Take the register lock, recording contention
+  * 
+  * The uncontended case is a single trylock; the clock is only read
+  * when the caller actually has to spin. Safe in any context.
+  * 
+  * @return Saved interrupt state for gpio_led_hw_unlock()
+  */
+ static unsigned long gpio_led_hw_lock(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   unsigned long flags;
+   u64 start;
+
+   if (raw_spin_trylock_irqsave(&dev->hw_lock, flags))
+      return flags;
+
+   start = ktime_get_ns();
+   raw_spin_lock_irqsave(&dev->hw_lock, flags);
+   this_cpu_inc(dev->stats->lock_contended);
+   this_cpu_add(dev->stats->lock_wait_ns, ktime_get_ns() - start);
+   return flags;
+ }
+
+ /**
+  * @brief Release the register lock taken by gpio_led_hw_lock()
+  * 
+  * @param flags Interrupt state returned by gpio_led_hw_lock()
+  */
+ static void gpio_led_hw_unlock(unsigned long flags) {
+   raw_spin_unlock_irqrestore(&gpio_led_device.hw_lock, flags);
+ }
+
+ /**
+  * @brief Set the PWM duty cycle of one pin
+  * 
+  * Duty 0 and GPIO_LED_PWM_MAX leave PWM mode and drive the pin statically.
+  * 
+  * @param gpio Managed BCM GPIO number
+  * @param duty High time in per mille of the period
+  * @return 0 on success, -EINVAL for unmanaged pins or out of range duty
+  */
+ static int gpio_led_set_pwm(unsigned int gpio, unsigned int duty) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   unsigned long flags;
+
+   if (gpio >= GPIO_MAX_PINS || !(dev->pin_mask & BIT_ULL(gpio)))
+      return -EINVAL;
+   if (duty > GPIO_LED_PWM_MAX)
+      return -EINVAL;
+
+   flags = gpio_led_hw_lock();
+   WRITE_ONCE(dev->pwm_duty[gpio], duty);
+   if (duty == 0 || duty == GPIO_LED_PWM_MAX) {
+      gpio_led_pwm_release(BIT_ULL(gpio));
+      if (duty)
+         gpio_led_write_regs(BIT_ULL(gpio), 0);
+      else
+         gpio_led_write_regs(0, BIT_ULL(gpio));
+   } else {
+      WRITE_ONCE(dev->pwm_mask, dev->pwm_mask | BIT_ULL(gpio));
+      gpio_led_pwm_build();
+   }
+
+   /* A dimmed pin reports as on */
+   if (duty)
+      WRITE_ONCE(dev->led_mask, dev->led_mask | BIT_ULL(gpio));
+   else
+      WRITE_ONCE(dev->led_mask, dev->led_mask & ~BIT_ULL(gpio));
+   gpio_led_hw_unlock(flags);
+
+   trace_gpio_led_pwm(gpio, duty);
+   return 0;
+ }
+
+ /**
+  * @brief Stop the PWM engine, leaving pins at their current levels
+  */
+ static void gpio_led_pwm_stop(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   unsigned long flags;
+
+   raw_spin_lock_irqsave(&dev->hw_lock, flags);
+   WRITE_ONCE(dev->pwm_mask, 0);
+   raw_spin_unlock_irqrestore(&dev->hw_lock, flags);
+
+   hrtimer_cancel(&dev->pwm_timer);
+   dev->pwm_running = false;
+ }
+
+ /**
+  * @brief Turn the LED off by writing to GPCLR register
+  * 
+  * @param pin Pin to clear
+  */
+ static void gpio_led_off(struct gpio_led_pin *pin) {
+   unsigned long flags;
+
+   /* Clear the pin to turn LED off */
+   flags = gpio_led_hw_lock();
+   gpio_led_pwm_release(BIT_ULL(pin->gpio));
+   gpio_led_writel(GPIO_BANK_BIT(pin->gpio), GPCLR0 + GPIO_BANK_OFFSET(pin->gpio));
+   WRITE_ONCE(gpio_led_device.led_mask, gpio_led_device.led_mask & ~BIT_ULL(pin->gpio));
+   gpio_led_hw_unlock(flags);
+   this_cpu_inc(gpio_led_device.stats->led_off);
+   trace_gpio_led_set(pin->gpio, 0);
+ }
+
+ /**
+  * @brief Turn the LED on by writing to GPSET register
+  * 
+  * @param pin Pin to set
+  */
+ static void gpio_led_on(struct gpio_led_pin *pin) {
+   unsigned long flags;
+
+   /* Set the pin to turn LED on */
+   flags = gpio_led_hw_lock();
+   gpio_led_pwm_release(BIT_ULL(pin->gpio));
+   gpio_led_writel(GPIO_BANK_BIT(pin->gpio), GPSET0 + GPIO_BANK_OFFSET(pin->gpio));
+   WRITE_ONCE(gpio_led_device.led_mask, gpio_led_device.led_mask | BIT_ULL(pin->gpio));
+   gpio_led_hw_unlock(flags);
+   this_cpu_inc(gpio_led_device.stats->led_on);
+   trace_gpio_led_set(pin->gpio, 1);
+ }
+
+ /**
+  * @brief Drive validated set/clear masks and update the LED state
+  * 
+  * Pins in PWM mode are taken out of it first. Must be called with
+  * hw_lock held.
+  * 
+  * @param set Pins to drive high, bit N for GPIO N
+  * @param clear Pins to drive low, bit N for GPIO N
+  */
+ static void gpio_led_write_mask(u64 set, u64 clear) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+
+   gpio_led_pwm_release(set | clear);
+   gpio_led_write_regs(set, clear);
+
+   WRITE_ONCE(dev->led_mask, (dev->led_mask | set) & ~clear);
+   this_cpu_add(dev->stats->led_on, hweight64(set));
+   this_cpu_add(dev->stats->led_off, hweight64(clear));
+   trace_gpio_led_set_mask(set, clear);
+ }
+
+ /**
+  * @brief Check set/clear masks from user space
+  * 
+  * @param set Pins to drive high, bit N for GPIO N
+  * @param clear Pins to drive low, bit N for GPIO N
+  * @return true if only managed pins are named and no pin is in both masks
+  */
+ static bool gpio_led_mask_valid(u64 set, u64 clear) {
+   return !((set | clear) & ~gpio_led_device.pin_mask) && !(set & clear);
+ }
+
+ /**
+  * @brief Drive several pins with one MMIO write per affected register
+  * 
+  * Exported for other kernel modules. Never sleeps, so it may be called
+  * from any context, including hard interrupt handlers.
+  * 
+  * @param set Pins to drive high, bit N for GPIO N
+  * @param clear Pins to drive low, bit N for GPIO N
+  * @return 0 on success, -EINVAL for unmanaged pins or overlapping masks
+  */
+ int gpio_led_set_multiple(u64 set, u64 clear) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   unsigned long flags;
+
+   if (!gpio_led_mask_valid(set, clear))
+      return -EINVAL;
+
+   flags = gpio_led_hw_lock();
+   gpio_led_write_mask(set, clear);
+   gpio_led_hw_unlock(flags);
+   return 0;
+ }
+ EXPORT_SYMBOL_GPL(gpio_led_set_multiple);
+
+ /**
+  * @brief Drive one managed pin high or low
+  * 
+  * Exported for other kernel modules. Never sleeps.
+  * 
+  * @param gpio Managed BCM GPIO number
+  * @param value 0 for low, anything else for high
+  * @return 0 on success, -EINVAL for unmanaged pins
+  */
+ int gpio_led_set_value(unsigned int gpio, int value) {
+   if (gpio >= GPIO_MAX_PINS)
+      return -EINVAL;
+
+   if (value)
+      return gpio_led_set_multiple(BIT_ULL(gpio), 0);
+   return gpio_led_set_multiple(0, BIT_ULL(gpio));
+ }
+ EXPORT_SYMBOL_GPL(gpio_led_set_value);
+
+ /**
+  * @brief Read the state last written to a managed pin
+  * 
+  * Exported for other kernel modules. Lockless, like read() on the
+  * per-pin device; PWM pins report 1 while dimmed.
+  * 
+  * @param gpio Managed BCM GPIO number
+  * @return 0 or 1, or -EINVAL for unmanaged pins
+  */
+ int gpio_led_get_value(unsigned int gpio) {
+   if (gpio >= GPIO_MAX_PINS || !(gpio_led_device.pin_mask & BIT_ULL(gpio)))
+      return -EINVAL;
+
+   return !!(READ_ONCE(gpio_led_device.led_mask) & BIT_ULL(gpio));
+ }
+ EXPORT_SYMBOL_GPL(gpio_led_get_value);
+
+ /**
+  * @brief Worker draining the command queue
+  * 
+  * Takes every queued command at once, folds them into a single set/clear
+  * pair where the last command for a pin wins (so on-then-off collapses
+  * to off), and applies the result with at most one write per GPSET/GPCLR
+  * register.
+  * 
+  * @param work The command work item
+  */
+ static void gpio_led_cmd_work(struct work_struct *work) {
+   struct gpio_led_dev *dev = container_of(work, struct gpio_led_dev, cmd_work);
+   struct gpio_led_cmd *cmd, *tmp;
+   struct llist_node *list;
+   u64 set = 0, clear = 0, seen = 0, pins;
+   unsigned int n = 0, coalesced = 0;
+   unsigned long flags;
+
+   list = llist_del_all(&dev->cmd_list);
+   if (!list)
+      return;
+
+   /*
+    * llist is LIFO, so the newest command comes first. Pins it names are
+    * final; older commands only contribute pins not seen yet, and one
+    * whose pins were all seen had no effect at all.
+    */
+   llist_for_each_entry_safe(cmd, tmp, list, node) {
+      pins = cmd->set | cmd->clear;
+      if (pins && !(pins & ~seen))
+         coalesced++;
+      set |= cmd->set & ~seen;
+      clear |= cmd->clear & ~seen;
+      seen |= pins;
+      kmem_cache_free(gpio_led_cmd_cache, cmd);
+      n++;
+   }
+
+   /* Let writers waiting for room queue again */
+   atomic_sub(n, &dev->cmd_depth);
+   wake_up_interruptible(&dev->cmd_wq);
+
+   flags = gpio_led_hw_lock();
+   gpio_led_write_mask(set, clear);
+   gpio_led_hw_unlock(flags);
+
+   this_cpu_add(dev->stats->cmds_coalesced, coalesced);
+ }
+
+ /**
+  * @brief Queue an LED update for the command worker
+  * 
+  * Lock-free for any number of concurrent writers: a slot is reserved with
+  * an atomic add, the command is pushed with llist_add() and the worker is
+  * kicked, which is a no-op while it is already pending. At most
+  * CMD_QUEUE_MAX commands are queued; beyond that the caller waits for the
+  * worker, or gets -EAGAIN if it must not block.
+  * 
+  * @param set Pins to drive high, bit N for GPIO N
+  * @param clear Pins to drive low, bit N for GPIO N
+  * @param nonblock Fail with -EAGAIN instead of waiting for room
+  * @return 0 on success, -EINVAL for invalid masks, -EAGAIN, -ERESTARTSYS
+  *         or -ENOMEM
+  */
+ static int gpio_led_queue_mask(u64 set, u64 clear, bool nonblock) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_led_cmd *cmd;
+
+   if (!gpio_led_mask_valid(set, clear))
+      return -EINVAL;
+
+   while (!atomic_add_unless(&dev->cmd_depth, 1, CMD_QUEUE_MAX)) {
+      if (nonblock)
+         return -EAGAIN;
+      if (wait_event_interruptible(dev->cmd_wq,
+                                   atomic_read(&dev->cmd_depth) < CMD_QUEUE_MAX))
+         return -ERESTARTSYS;
+   }
+
+   cmd = kmem_cache_alloc(gpio_led_cmd_cache, GFP_KERNEL);
+   if (!cmd) {
+      atomic_dec(&dev->cmd_depth);
+      return -ENOMEM;
+   }
+
+   cmd->set = set;
+   cmd->clear = clear;
+   llist_add(&cmd->node, &dev->cmd_list);
+   queue_work(system_highpri_wq, &dev->cmd_work);
+   this_cpu_inc(dev->stats->cmds_queued);
+   return 0;
+ }
+
+ /**
+  * @brief Wait until every queued command has reached the hardware
+  * 
+  * Every push is followed by queue_work(), so once the last queued run of
+  * the worker has finished, all commands pushed before this call are
+  * applied.
+  */
+ static void gpio_led_sync(void) {
+   flush_work(&gpio_led_device.cmd_work);
+ }
+
+ /**
+  * @brief Handler for fsync() on /dev/gpio_led<N> and /dev/gpio_bank
+  * 
+  * @param file Pointer to file structure
+  * @param start Unused
+  * @param end Unused
+  * @param datasync Unused
+  * @return 0
+  */
+ static int gpio_led_fsync(struct file *file, loff_t start, loff_t end, int datasync) {
+   gpio_led_sync();
+   return 0;
+ }
+
+ /**
+  * @brief Sequencer timer callback, applies one step per expiry
+  * 
+  * Runs in hard interrupt context, also on PREEMPT_RT since the timer
+  * uses HRTIMER_MODE_REL_HARD. The next expiry is computed from the
+  * previous one rather than from the current time, so step durations do
+  * not accumulate callback latency.
+  * 
+  * @param timer The sequencer timer
+  * @return HRTIMER_RESTART while steps remain, HRTIMER_NORESTART at the end
+  */
+ static enum hrtimer_restart gpio_led_seq_fn(struct hrtimer *timer) {
+   struct gpio_led_dev *dev = container_of(timer, struct gpio_led_dev, seq_timer);
+   const struct gpio_led_step *step;
+
+   if (dev->seq_next == dev->seq_count) {
+      if (!dev->seq_loop)
+         return HRTIMER_NORESTART;
+      dev->seq_next = 0;
+   }
+   step = &dev->seq_steps[dev->seq_next++];
+
+   raw_spin_lock(&dev->hw_lock);
+   if (step->level)
+      gpio_led_write_mask(step->mask, 0);
+   else
+      gpio_led_write_mask(0, step->mask);
+   raw_spin_unlock(&dev->hw_lock);
+
+   hrtimer_add_expires_ns(timer, step->duration_ns);
+   return HRTIMER_RESTART;
+ }
+
+ /**
+  * @brief Stop the sequencer and free its steps
+  * 
+  * Must be called with seq_lock held (or at unload).
+  */
+ static void gpio_led_seq_stop(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+
+   /* Waits for a running callback to finish */
+   hrtimer_cancel(&dev->seq_timer);
+   kvfree(dev->seq_steps);
+   dev->seq_steps = NULL;
+   dev->seq_count = 0;
+   dev->seq_next = 0;
+ }
+
+ /**
+  * @brief Validate and start a sequence uploaded by GPIO_LED_IOC_SEQ_START
+  * 
+  * The whole array is checked before the running sequence is replaced.
+  * The first step is applied immediately.
+  * 
+  * @param useq User space request header
+  * @return 0 on success, or negative error code
+  */
+ static long gpio_led_seq_start(struct gpio_led_seq __user *useq) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_led_step *steps;
+   struct gpio_led_seq seq;
+   unsigned int i;
+
+   if (copy_from_user(&seq, useq, sizeof(seq)))
+      return -EFAULT;
+   if (seq.flags & ~GPIO_LED_SEQ_LOOP)
+      return -EINVAL;
+   if (seq.count < 1 || seq.count > GPIO_LED_SEQ_MAX)
+      return -EINVAL;
+
+   steps = vmemdup_user(u64_to_user_ptr(seq.steps), array_size(seq.count, sizeof(*steps)));
+   if (IS_ERR(steps))
+      return PTR_ERR(steps);
+
+   for (i = 0; i < seq.count; i++) {
+      if ((steps[i].mask & ~dev->pin_mask) || steps[i].level > 1 ||
+          steps[i].reserved || steps[i].duration_ns < GPIO_LED_SEQ_MIN_NS) {
+         kvfree(steps);
+         return -EINVAL;
+      }
+   }
+
+   if (mutex_lock_interruptible(&dev->seq_lock)) {
+      kvfree(steps);
+      return -ERESTARTSYS;
+   }
+
+   /* Earlier queued writes must not land on top of the first steps */
+   if (queued)
+      gpio_led_sync();
+
+   gpio_led_seq_stop();
+   dev->seq_steps = steps;
+   dev->seq_count = seq.count;
+   dev->seq_loop = seq.flags & GPIO_LED_SEQ_LOOP;
+   hrtimer_start(&dev->seq_timer, 0, HRTIMER_MODE_REL_HARD);
+
+   mutex_unlock(&dev->seq_lock);
+   return 0;
+ }
+
+ /**
+  * @brief Account the result of a read or write in the per-CPU counters
+  * 
+  * @param write true for writes, false for reads
+  * @param ret Return value of the operation
+  */
+ static void gpio_led_stats_account(bool write, ssize_t ret) {
+   struct gpio_led_stats __percpu *stats = gpio_led_device.stats;
+
+   if (ret >= 0) {
+      if (write) {
+         this_cpu_inc(stats->writes);
+         this_cpu_add(stats->write_bytes, ret);
+      } else {
+         this_cpu_inc(stats->reads);
+         this_cpu_add(stats->read_bytes, ret);
+      }
+   } else if (ret == -EFAULT) {
+      this_cpu_inc(stats->efault);
+   } else if (ret == -ERESTARTSYS) {
+      this_cpu_inc(stats->erestartsys);
+   }
+ }
+
+ /**
+  * @brief Handler for device open() operation
+  * 
+  * Called when a process opens our device file. The minor selects
+  * which managed pin the file controls.
+  * 
+  * @param inode Pointer to inode structure of the device
+  * @param file Pointer to file structure for this open instance
+  * @return 0 on success, -ENODEV for an unknown minor
+  */
+ static int gpio_led_open(struct inode *inode, struct file *file) {
+   unsigned int idx = iminor(inode) - MINOR(gpio_led_device.dev_num);
+   struct gpio_led_pin *pin;
+
+   if (idx >= gpio_led_device.nr_pins)
+      return -ENODEV;
+
+   /* Store the pin in the file's private_data for later use */
+   pin = &gpio_led_device.pins[idx];
+   file->private_data = pin;
+
+   /* Trace the open operation (no logging on this hot path) */
+   trace_gpio_led_open(pin->gpio);
+   return 0;
+ }
+
+ /**
+ * @brief Handler for device close() operation
+ *
+ * Called when a process closes our device file.
+ *
+ * @param inode Pointer to inode structure of the device
+ * @param file Pointer to file structure for this open instance
+ * @return 0 on success
+ */
+ static int gpio_led_release(struct inode *inode, struct file *file) {
+   struct gpio_led_pin *pin = file->private_data;
+
+   /* Trace the close operation (no logging on this hot path) */
+   trace_gpio_led_release(pin->gpio);
+   return 0;
+ }
+
+ /**
+  * @brief Copy the current LED status to user space
+  * 
+  * Runs without the device lock: the state is a single READ_ONCE of the
+  * LED bitmap and the text comes from a precomputed string, so status
+  * readers never contend with writers.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer to copy data to
+  * @param count Number of bytes to read
+  * @param pos Current position in file
+  * @return Number of bytes read, or negative error code
+  */
+ static ssize_t gpio_led_do_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_pin *pin = file->private_data;
+   size_t status_size = sizeof(gpio_led_status[0]) - 1;
+   unsigned int state;
+
+   /* Only proceed if we haven't sent data yet */
+   if (*pos > 0) {
+      return 0;
+   }
+
+   state = !!(READ_ONCE(gpio_led_device.led_mask) & BIT_ULL(pin->gpio));
+
+   /* Only copy up to the user's requested amount */
+   if (count < status_size) {
+      status_size = count;
+   }
+
+   /* Copy to user space */
+   if (copy_to_user(buf, gpio_led_status[state], status_size)) {
+      return -EFAULT;
+   }
+
+   /* Update position and return bytes read */
+   *pos += status_size;
+   return status_size;
+ }
+
+ /**
+  * @brief Handler for ioctl() on /dev/gpio_led<N>
+  * 
+  * GPIO_LED_IOC_GET_STATE returns the binary status of the pin. Like
+  * read() it takes no lock; the fields are read individually.
+  * 
+  * @param file Pointer to file structure
+  * @param cmd ioctl command number (GPIO_LED_IOC_*)
+  * @param arg User space argument
+  * @return 0 on success, or negative error code
+  */
+ static long gpio_led_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+   struct gpio_led_pin *pin = file->private_data;
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_led_state st = { .gpio = pin->gpio };
+
+   switch (cmd) {
+    case GPIO_LED_IOC_GET_STATE:
+        st.level = !!(READ_ONCE(dev->led_mask) & BIT_ULL(pin->gpio));
+        if (READ_ONCE(dev->pwm_mask) & BIT_ULL(pin->gpio)) {
+            st.flags = GPIO_LED_STATE_PWM;
+            st.duty = READ_ONCE(dev->pwm_duty[pin->gpio]);
+        }
+        if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+            return -EFAULT;
+        return 0;
+
+    default:
+        return -ENOTTY;
+   }
+ }
+
+ /**
+  * @brief Control the LED based on user input
+  * 
+  * Write '1' to turn LED on, '0' to turn LED off, or 'p' followed by a
+  * duty cycle in per mille (e.g. "p250") to dim it with software PWM.
+  * In queued mode on/off are handed to the command worker. Other input
+  * is rejected with -EINVAL.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer to copy data from
+  * @param count Number of bytes to write
+  * @param pos Current position in file
+  * @return Number of bytes written, or negative error code
+  */
+ static ssize_t gpio_led_do_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_pin *pin = file->private_data;
+   unsigned int duty;
+   char cmd[8];
+   ssize_t ret = 0;
+
+   /* Check for valid data */
+   if (count < 1) {
+      return -EINVAL;
+   }
+   
+   /* Truncate input to prevent buffer overflow */
+   if (count > sizeof(cmd) - 1) {
+      count = sizeof(cmd) - 1;
+   }
+
+   /* Copy command from user space */
+   if (copy_from_user(cmd, buf, count)) {
+      return -EFAULT;
+   }
+
+   /* Null-terminate the command */
+   cmd[count] = '\0';
+
+   /* In queued mode on/off go to the worker without taking the lock */
+   if (queued && (cmd[0] == LED_CMD_ON || cmd[0] == LED_CMD_OFF)) {
+      if (cmd[0] == LED_CMD_ON)
+         ret = gpio_led_queue_mask(BIT_ULL(pin->gpio), 0, file->f_flags & O_NONBLOCK);
+      else
+         ret = gpio_led_queue_mask(0, BIT_ULL(pin->gpio), file->f_flags & O_NONBLOCK);
+      return ret ? ret : count;
+   }
+
+   /* Each command takes the register spinlock only around its MMIO writes */
+   switch (cmd[0]) {
+    case LED_CMD_ON:
+        gpio_led_on(pin);
+        break;
+    
+    case LED_CMD_OFF:
+        gpio_led_off(pin);
+        break;
+
+    case LED_CMD_PWM:
+        ret = kstrtouint(cmd + 1, 10, &duty);
+        if (ret)
+            return ret;
+        /* Earlier queued writes must not land after the PWM change */
+        if (queued)
+            gpio_led_sync();
+        ret = gpio_led_set_pwm(pin->gpio, duty);
+        if (ret)
+            return ret;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    /* Return the number of bytes processed */
+    return count;
+ }
+
+ /**
+  * @brief Handler for device read() operation
+  * 
+  * Reports the LED status, updates the statistics and traces the call
+  * with its latency.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer to copy data to
+  * @param count Number of bytes to read
+  * @param pos Current position in file
+  * @return Number of bytes read, or negative error code
+  */
+ static ssize_t gpio_led_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_pin *pin = file->private_data;
+   u64 start = 0;
+   ssize_t ret;
+
+   if (trace_gpio_led_read_enabled())
+      start = ktime_get_ns();
+
+   ret = gpio_led_do_read(file, buf, count, pos);
+   gpio_led_stats_account(false, ret);
+
+   if (start)
+      trace_gpio_led_read(pin->gpio, count, ret, ktime_get_ns() - start);
+   return ret;
+ }
+
+ /**
+  * @brief Handler for device write() operation
+  * 
+  * Controls the LED, updates the statistics and traces the call with its
+  * latency.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer to copy data from
+  * @param count Number of bytes to write
+  * @param pos Current position in file
+  * @return Number of bytes written, or negative error code
+  */
+ static ssize_t gpio_led_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_pin *pin = file->private_data;
+   u64 start = 0;
+   ssize_t ret;
+
+   if (trace_gpio_led_write_enabled())
+      start = ktime_get_ns();
+
+   ret = gpio_led_do_write(file, buf, count, pos);
+   gpio_led_stats_account(true, ret);
+
+   if (start)
+      trace_gpio_led_write(pin->gpio, count, ret, ktime_get_ns() - start);
+   return ret;
+ }
+
+ /**
+  * @brief Snapshot the hardware levels of the managed pins
+  * 
+  * Reads GPLEV0 and GPLEV1 only if a managed pin lives in that bank, so a
+  * snapshot costs one or two MMIO reads. Levels within one bank are
+  * sampled at the same instant.
+  * 
+  * @param levels Filled with the snapshot
+  */
+ static void gpio_led_get_levels(struct gpio_led_levels *levels) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   u64 mask = dev->pin_mask | dev->in_mask;
+   u64 value = 0;
+
+   levels->timestamp_ns = ktime_get_ns();
+   if (lower_32_bits(mask))
+      value |= gpio_led_readl(GPLEV0);
+   if (upper_32_bits(mask))
+      value |= (u64)gpio_led_readl(GPLEV1) << 32;
+
+   levels->levels = value & mask;
+   levels->mask = mask;
+ }
+
+ /**
+  * @brief Handler for read() on /dev/gpio_bank
+  * 
+  * Returns one snapshot of all managed pins as "<gpio>=<level>" pairs.
+  * Like the per-pin files, only a read at position 0 returns data; use
+  * pread() at offset 0 to take a new snapshot on the same file.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer to copy data to
+  * @param count Number of bytes to read
+  * @param pos Current position in file
+  * @return Number of bytes read, or negative error code
+  */
+ static ssize_t gpio_led_bank_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
+   char text[GPIO_MAX_PINS * sizeof("53=1 ") + 1];
+   struct gpio_led_levels levels;
+   unsigned int gpio;
+   size_t len = 0;
+   ssize_t ret;
+
+   if (*pos > 0)
+      return 0;
+
+   gpio_led_get_levels(&levels);
+   for (gpio = 0; gpio < GPIO_MAX_PINS; gpio++) {
+      if (levels.mask & BIT_ULL(gpio))
+         len += scnprintf(text + len, sizeof(text) - len, "%s%u=%u", len ? " " : "",
+                          gpio, !!(levels.levels & BIT_ULL(gpio)));
+   }
+   len += scnprintf(text + len, sizeof(text) - len, "\n");
+
+   if (count < len)
+      len = count;
+
+   if (copy_to_user(buf, text, len)) {
+      ret = -EFAULT;
+   } else {
+      *pos += len;
+      ret = len;
+   }
+
+   gpio_led_stats_account(false, ret);
+   return ret;
+ }
+
+ /**
+  * @brief Handler for write() on /dev/gpio_bank
+  * 
+  * Takes an array of struct gpio_led_mask and applies the entries in order,
+  * BANK_BATCH entries per lock acquisition, or folds them into a single
+  * queued command in queued mode. A trailing partial entry is ignored.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space array of struct gpio_led_mask
+  * @param count Number of bytes to write
+  * @param pos Current position in file (unused)
+  * @return Number of bytes consumed, or negative error code
+  */
+ static ssize_t gpio_led_bank_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_mask batch[BANK_BATCH];
+   size_t done = 0, n, valid, i;
+   u64 set = 0, clear = 0;
+   unsigned long flags;
+   ssize_t ret = 0;
+   int err;
+
+   if (count < sizeof(*batch)) {
+      ret = -EINVAL;
+      goto out;
+   }
+
+   /*
+    * Copy a batch onto the stack, then apply its valid prefix under one
+    * acquisition of the register spinlock, which is never held across
+    * a user copy. In queued mode the whole write is folded into one
+    * command instead, with the last mask for a pin winning.
+    */
+   while (count - done >= sizeof(*batch)) {
+      n = min_t(size_t, (count - done) / sizeof(*batch), BANK_BATCH);
+      if (copy_from_user(batch, buf + done, n * sizeof(*batch))) {
+         ret = -EFAULT;
+         break;
+      }
+
+      for (valid = 0; valid < n; valid++)
+         if (!gpio_led_mask_valid(batch[valid].set, batch[valid].clear))
+            break;
+
+      if (queued) {
+         for (i = 0; i < valid; i++) {
+            set = (set & ~batch[i].clear) | batch[i].set;
+            clear = (clear & ~batch[i].set) | batch[i].clear;
+         }
+      } else {
+         flags = gpio_led_hw_lock();
+         for (i = 0; i < valid; i++)
+            gpio_led_write_mask(batch[i].set, batch[i].clear);
+         gpio_led_hw_unlock(flags);
+      }
+
+      done += valid * sizeof(*batch);
+      if (valid < n) {
+         ret = -EINVAL;
+         break;
+      }
+   }
+
+   /* Nothing counts as written unless the folded command was queued */
+   if (queued && done) {
+      err = gpio_led_queue_mask(set, clear, file->f_flags & O_NONBLOCK);
+      if (err) {
+         ret = err;
+         done = 0;
+      }
+   }
+
+   /* Report partial progress before the first failing entry */
+   if (done)
+      ret = done;
+
+out:
+   gpio_led_stats_account(true, ret);
+   return ret;
+ }
+
+ /**
+  * @brief Handler for ioctl() on /dev/gpio_bank
+  * 
+  * @param file Pointer to file structure
+  * @param cmd ioctl command number (GPIO_LED_IOC_*)
+  * @param arg User space argument
+  * @return 0 on success, or negative error code
+  */
+ static long gpio_led_bank_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_led_mask mask;
+   struct gpio_led_levels levels;
+   struct gpio_led_fsel fsel;
+   struct gpio_led_pwm pwm;
+
+   switch (cmd) {
+    case GPIO_LED_IOC_SET_CLEAR:
+        if (copy_from_user(&mask, (void __user *)arg, sizeof(mask)))
+            return -EFAULT;
+        if (queued)
+            return gpio_led_queue_mask(mask.set, mask.clear, file->f_flags & O_NONBLOCK);
+        return gpio_led_set_multiple(mask.set, mask.clear);
+
+    case GPIO_LED_IOC_SEQ_START:
+        return gpio_led_seq_start((struct gpio_led_seq __user *)arg);
+
+    case GPIO_LED_IOC_SYNC:
+        gpio_led_sync();
+        return 0;
+
+    case GPIO_LED_IOC_SET_FUNCTIONS:
+        if (copy_from_user(&fsel, (void __user *)arg, sizeof(fsel)))
+            return -EFAULT;
+        return gpio_led_apply_functions(&fsel);
+
+    case GPIO_LED_IOC_GET_LEVELS:
+        gpio_led_get_levels(&levels);
+        if (copy_to_user((void __user *)arg, &levels, sizeof(levels)))
+            return -EFAULT;
+        return 0;
+
+    case GPIO_LED_IOC_SET_PWM:
+        if (copy_from_user(&pwm, (void __user *)arg, sizeof(pwm)))
+            return -EFAULT;
+        if (queued)
+            gpio_led_sync();
+        return gpio_led_set_pwm(pwm.gpio, pwm.duty);
+
+    case GPIO_LED_IOC_SEQ_STOP:
+        if (mutex_lock_interruptible(&dev->seq_lock))
+            return -ERESTARTSYS;
+        gpio_led_seq_stop();
+        mutex_unlock(&dev->seq_lock);
+        return 0;
+
+    default:
+        return -ENOTTY;
+   }
+ }
+
+ /**
+  * @brief Handler for writes to the debugfs sim_input file
+  * 
+  * Takes "<gpio> <level>" and drives that level onto the pin from the
+  * outside, as a button or sensor would, latching edges on inputs.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer with the command
+  * @param count Number of bytes written
+  * @param pos Current position in file
+  * @return count on success, or negative error code
+  */
+ static ssize_t gpio_led_sim_input_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_sim *sim = &gpio_led_sim;
+   unsigned int gpio, level;
+   unsigned long flags;
+   char cmd[32];
+   u64 old;
+
+   if (count >= sizeof(cmd))
+      return -EINVAL;
+   if (copy_from_user(cmd, buf, count))
+      return -EFAULT;
+   cmd[count] = '\0';
+
+   if (sscanf(cmd, "%u %u", &gpio, &level) != 2 || gpio >= GPIO_MAX_PINS || level > 1)
+      return -EINVAL;
+
+   raw_spin_lock_irqsave(&sim->lock, flags);
+   old = gpio_led_sim_level();
+   if (level)
+      sim->ext |= BIT_ULL(gpio);
+   else
+      sim->ext &= ~BIT_ULL(gpio);
+   gpio_led_sim_edges(old);
+   raw_spin_unlock_irqrestore(&sim->lock, flags);
+
+   return count;
+ }
+
+ /* File operations for the debugfs sim_input file */
+ static const struct file_operations gpio_led_sim_input_fops = {
+    .owner = THIS_MODULE,
+    .write = gpio_led_sim_input_write,
+ };
+
+ /**
+  * @brief Limit the gpiolib lines to the managed outputs and inputs
+  * 
+  * The chip spans GPIO 0..53 so line offsets equal BCM GPIO numbers;
+  * every other line is reported as unavailable.
+  * 
+  * @param gc The gpio_chip
+  * @param valid_mask Filled with one bit per usable line
+  * @param ngpios Number of lines (GPIO_MAX_PINS)
+  * @return 0
+  */
+ static int gpio_led_chip_init_valid_mask(struct gpio_chip *gc, unsigned long *valid_mask,
+                                          unsigned int ngpios) {
+   bitmap_from_u64(valid_mask, gpio_led_device.pin_mask | gpio_led_device.in_mask);
+   return 0;
+ }
+
+ /**
+  * @brief Report the direction of a line from the GPFSEL shadows
+  * 
+  * @param gc The gpio_chip
+  * @param offset BCM GPIO number
+  * @return GPIO_LINE_DIRECTION_IN for inputs, GPIO_LINE_DIRECTION_OUT otherwise
+  */
+ static int gpio_led_chip_get_direction(struct gpio_chip *gc, unsigned int offset) {
+   u32 fsel = READ_ONCE(gpio_led_device.fsel[offset / 10]);
+
+   if (((fsel >> ((offset % 10) * 3)) & 7) == GPIO_FUNCTION_IN)
+      return GPIO_LINE_DIRECTION_IN;
+   return GPIO_LINE_DIRECTION_OUT;
+ }
+
+ /**
+  * @brief Switch a line to input
+  * 
+  * Only input pins are accepted, and they already are inputs. Output
+  * pins stay outputs, as /dev/gpio_led, the bank device and the PWM and
+  * sequence engines keep driving them.
+  * 
+  * @param gc The gpio_chip
+  * @param offset BCM GPIO number
+  * @return 0 for input pins, -EPERM for output pins
+  */
+ static int gpio_led_chip_direction_input(struct gpio_chip *gc, unsigned int offset) {
+   if (gpio_led_device.pin_mask & BIT_ULL(offset))
+      return -EPERM;
+   return 0;
+ }
+
+ /**
+  * @brief Drive a line and switch it to output
+  * 
+  * The level is latched before the function changes, so the pin never
+  * glitches. Input pins stay inputs, as their edge events belong to
+  * /dev/gpio_in<N>.
+  * 
+  * @param gc The gpio_chip
+  * @param offset BCM GPIO number
+  * @param value Initial level
+  * @return 0 on success, -EPERM for input pins
+  */
+ static int gpio_led_chip_direction_output(struct gpio_chip *gc, unsigned int offset, int value) {
+   u64 fsel_masks[GPIO_LED_FUNC_COUNT] = {0};
+   int ret;
+
+   ret = gpio_led_set_value(offset, value);
+   if (ret)
+      return -EPERM;
+
+   fsel_masks[GPIO_FUNCTION_OUT] = BIT_ULL(offset);
+   gpio_led_set_functions(fsel_masks);
+   return 0;
+ }
+
+ /**
+  * @brief Read the hardware level of one line from GPLEV
+  * 
+  * @param gc The gpio_chip
+  * @param offset BCM GPIO number
+  * @return 0 or 1
+  */
+ static int gpio_led_chip_get(struct gpio_chip *gc, unsigned int offset) {
+   return !!(gpio_led_readl(GPLEV0 + GPIO_BANK_OFFSET(offset)) & GPIO_BANK_BIT(offset));
+ }
+
+ /**
+  * @brief Read many lines with at most one MMIO read per GPLEV register
+  * 
+  * @param gc The gpio_chip
+  * @param mask Lines to read
+  * @param bits Updated with the levels of the lines in mask
+  * @return 0
+  */
+ static int gpio_led_chip_get_multiple(struct gpio_chip *gc, unsigned long *mask,
+                                       unsigned long *bits) {
+   u64 want, value = 0, cur;
+
+   bitmap_to_arr64(&want, mask, GPIO_MAX_PINS);
+   if (lower_32_bits(want))
+      value |= gpio_led_readl(GPLEV0);
+   if (upper_32_bits(want))
+      value |= (u64)gpio_led_readl(GPLEV1) << 32;
+
+   bitmap_to_arr64(&cur, bits, GPIO_MAX_PINS);
+   cur = (cur & ~want) | (value & want);
+   bitmap_from_arr64(bits, &cur, GPIO_MAX_PINS);
+   return 0;
+ }
+
+ /**
+  * @brief Drive one line through the same path as /dev/gpio_led<N>
+  * 
+  * @param gc The gpio_chip
+  * @param offset BCM GPIO number
+  * @param value Level to drive
+  */
+ static void gpio_led_chip_set(struct gpio_chip *gc, unsigned int offset, int value) {
+   gpio_led_set_value(offset, value);
+ }
+
+ /**
+  * @brief Drive many lines with one write per GPSET/GPCLR register
+  * 
+  * @param gc The gpio_chip
+  * @param mask Lines to drive
+  * @param bits Levels for the lines in mask
+  */
+ static void gpio_led_chip_set_multiple(struct gpio_chip *gc, unsigned long *mask,
+                                        unsigned long *bits) {
+   u64 lines, levels;
+
+   bitmap_to_arr64(&lines, mask, GPIO_MAX_PINS);
+   bitmap_to_arr64(&levels, bits, GPIO_MAX_PINS);
+   lines &= gpio_led_device.pin_mask;
+   gpio_led_set_multiple(lines & levels, lines & ~levels);
+ }
+
+ #ifdef CONFIG_GPIOLIB_IRQCHIP
+ /**
+  * @brief Stop delivering edges of one input to its gpiolib IRQ
+  * 
+  * The hardware keeps detecting both edges for /dev/gpio_in<N>; masking
+  * only filters what gpio_led_in_event() forwards.
+  * 
+  * @param d IRQ data of the line
+  */
+ static void gpio_led_chip_irq_mask(struct irq_data *d) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   irq_hw_number_t hwirq = irqd_to_hwirq(d);
+   unsigned long flags;
+
+   raw_spin_lock_irqsave(&dev->hw_lock, flags);
+   WRITE_ONCE(dev->irq_enabled, dev->irq_enabled & ~BIT_ULL(hwirq));
+   raw_spin_unlock_irqrestore(&dev->hw_lock, flags);
+   gpiochip_disable_irq(&dev->chip, hwirq);
+ }
+
+ /**
+  * @brief Resume delivering edges of one input to its gpiolib IRQ
+  * 
+  * @param d IRQ data of the line
+  */
+ static void gpio_led_chip_irq_unmask(struct irq_data *d) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   irq_hw_number_t hwirq = irqd_to_hwirq(d);
+   unsigned long flags;
+
+   gpiochip_enable_irq(&dev->chip, hwirq);
+   raw_spin_lock_irqsave(&dev->hw_lock, flags);
+   WRITE_ONCE(dev->irq_enabled, dev->irq_enabled | BIT_ULL(hwirq));
+   raw_spin_unlock_irqrestore(&dev->hw_lock, flags);
+ }
+
+ /**
+  * @brief Select which edges of an input are forwarded to its gpiolib IRQ
+  * 
+  * @param d IRQ data of the line
+  * @param type IRQ_TYPE_EDGE_RISING, IRQ_TYPE_EDGE_FALLING or IRQ_TYPE_EDGE_BOTH
+  * @return 0 on success, -EINVAL for level triggers
+  */
+ static int gpio_led_chip_irq_set_type(struct irq_data *d, unsigned int type) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   u64 bit = BIT_ULL(irqd_to_hwirq(d));
+   unsigned long flags;
+
+   if (!(type & IRQ_TYPE_EDGE_BOTH) || (type & IRQ_TYPE_LEVEL_MASK))
+      return -EINVAL;
+
+   raw_spin_lock_irqsave(&dev->hw_lock, flags);
+   WRITE_ONCE(dev->irq_rise, type & IRQ_TYPE_EDGE_RISING ?
+              dev->irq_rise | bit : dev->irq_rise & ~bit);
+   WRITE_ONCE(dev->irq_fall, type & IRQ_TYPE_EDGE_FALLING ?
+              dev->irq_fall | bit : dev->irq_fall & ~bit);
+   raw_spin_unlock_irqrestore(&dev->hw_lock, flags);
+   return 0;
+ }
+
+ /**
+  * @brief Only input pins can raise gpiolib IRQs
+  * 
+  * @param gc The gpio_chip
+  * @param valid_mask Filled with one bit per line that has an IRQ
+  * @param ngpios Number of lines (GPIO_MAX_PINS)
+  */
+ static void gpio_led_chip_irq_valid_mask(struct gpio_chip *gc, unsigned long *valid_mask,
+                                          unsigned int ngpios) {
+   bitmap_from_u64(valid_mask, gpio_led_device.in_mask);
+ }
+
+ static const struct irq_chip gpio_led_irq_chip = {
+    .name = DRIVER_NAME,
+    .irq_mask = gpio_led_chip_irq_mask,
+    .irq_unmask = gpio_led_chip_irq_unmask,
+    .irq_set_type = gpio_led_chip_irq_set_type,
+    .flags = IRQCHIP_IMMUTABLE,
+    GPIOCHIP_IRQ_RESOURCE_HELPERS,
+ };
+ #endif /* CONFIG_GPIOLIB_IRQCHIP */
+
+ /**
+  * @brief Forward an input edge to the gpiolib IRQ of its line
+  * 
+  * Called from gpio_led_in_event() for every edge. Does nothing unless the
+  * line's IRQ is unmasked and wants this edge.
+  * 
+  * @param gpio Input that changed
+  * @param level Level sampled after the edge
+  */
+ static void gpio_led_chip_edge(unsigned int gpio, bool level) {
+ #ifdef CONFIG_GPIOLIB_IRQCHIP
+   struct gpio_led_dev *dev = &gpio_led_device;
+   u64 wanted = level ? READ_ONCE(dev->irq_rise) : READ_ONCE(dev->irq_fall);
+
+   if (READ_ONCE(dev->irq_enabled) & wanted & BIT_ULL(gpio))
+      generic_handle_domain_irq(dev->chip.irq.domain, gpio);
+ #endif
+ }
+
+ /**
+  * @brief Register the managed pins with gpiolib
+  * 
+  * Must be called once the bank device and the inputs exist. Lines are
+  * BCM GPIO numbers; inputs also get edge IRQs, which is what the GPIO
+  * character device uses for its timestamped edge events.
+  * 
+  * @return 0 on success, negative error code on failure
+  */
+ static int gpio_led_chip_init(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_chip *gc = &dev->chip;
 
- /* Register offsets */
- #define GPFSEL0               0x00        /* GPIO Function Select 0 */
- #define GPFSEL1               0x04        /* GPIO Function Select 1 */
- #define GPFSEL2               0x08        /* GPIO Function Select 2 */
- #define GPSET0                0x1C        /* GPIO Pin Output Set 0 */
- #define GPCLR0                0x28        /* GPIO Pin Output Clear 0 */
+   gc->label = DRIVER_NAME;
+   gc->parent = dev->bank_device;
+   gc->owner = THIS_MODULE;
+   gc->base = -1;
+   gc->ngpio = GPIO_MAX_PINS;
+   gc->can_sleep = false;
+   gc->init_valid_mask = gpio_led_chip_init_valid_mask;
+   gc->get_direction = gpio_led_chip_get_direction;
+   gc->direction_input = gpio_led_chip_direction_input;
+   gc->direction_output = gpio_led_chip_direction_output;
+   gc->get = gpio_led_chip_get;
+   gc->get_multiple = gpio_led_chip_get_multiple;
+   gc->set = gpio_led_chip_set;
+   gc->set_multiple = gpio_led_chip_set_multiple;
 
- /* GPIO function select values */
- #define GPIO_FUNCTION_IN      0           /* Input */
- #define GPIO_FUNCTION_OUT     1           /* Output */
+ #ifdef CONFIG_GPIOLIB_IRQCHIP
+   if (dev->nr_inputs) {
+      gpio_irq_chip_set_chip(&gc->irq, &gpio_led_irq_chip);
+      gc->irq.handler = handle_simple_irq;
+      gc->irq.default_type = IRQ_TYPE_NONE;
+      gc->irq.init_valid_mask = gpio_led_chip_irq_valid_mask;
+   }
+ #endif
 
- /* Command values for LED control via write operation */
- #define LED_CMD_ON    '1'     /* Turn LED on */
- #define LED_CMD_OFF   '0'     /* Turn LED off */
+   return gpiochip_add_data(gc, dev);
+ }
 
  /**
-  * Device structure holding all driver state information
+  * @brief Enable or disable rising and falling edge detection
+  * 
+  * @param mask Pins to update, bit N for GPIO N
+  * @param enable true to enable detection, false to disable it
   */
- struct gpio_led_dev {
-    struct mutex lock;         /* Mutex to protect concurent access */
-    unsigned char *buffer;     /* Memory buffer to store data */
-    size_t buffer_size;        /* Current amount of data in buffer */
-    dev_t dev_num;             /* Device number (major + minor) */
-    struct cdev cdev;          /* Character device structure */
-    struct class *class;       /* Device class */
-    struct device *device;     /* Device structure */
-    void __iomem *gpio_base;    /* Virtual address of GPIO registers */
-    int led_state;             /* Current LED state (0 = off, 1 = on)*/
- };
+ static void gpio_led_set_edges(u64 mask, bool enable) {
+   unsigned long flags;
+   unsigned int bank;
+   u32 bits, value;
 
- /* Global instance of our device */
- static struct gpio_led_dev gpio_led_device = {0};
+   raw_spin_lock_irqsave(&gpio_led_device.hw_lock, flags);
+   for (bank = 0; bank < 2; bank++) {
+      bits = bank ? upper_32_bits(mask) : lower_32_bits(mask);
+      if (!bits)
+         continue;
 
- /* Forward declarations for file operations */
- static int gpio_led_open(struct inode *inode, struct file *file);
- static int gpio_led_release(struct inode *inode, struct file *file);
- static ssize_t gpio_led_read(struct file *file, char __user *buf, size_t count, loff_t *pos);
- static ssize_t gpio_led_write(struct file *file, const char __user *buf, size_t count, loff_t *pos);
+      value = gpio_led_readl(GPREN0 + bank * 4);
+      gpio_led_writel(enable ? value | bits : value & ~bits, GPREN0 + bank * 4);
+      value = gpio_led_readl(GPFEN0 + bank * 4);
+      gpio_led_writel(enable ? value | bits : value & ~bits, GPFEN0 + bank * 4);
 
-/**
- * File operation structure defining the driver's capabilities
- */
- static const struct file_operations gpio_led_fops = {
-    .owner = THIS_MODULE,           /* Module that owns this structure */
-    .open = gpio_led_open,          /* Called on open() */
-    .release = gpio_led_release,    /* Called on close() */
-    .read = gpio_led_read,          /* Called on read() */
-    .write = gpio_led_write,        /* Called on write() */
- };
+      /* Drop events latched before the change */
+      gpio_led_writel(bits, GPEDS0 + bank * 4);
+   }
+   raw_spin_unlock_irqrestore(&gpio_led_device.hw_lock, flags);
+ }
 
  /**
-  * @brief Configure the GPIO pin for LED as output
+  * @brief Queue one timestamped edge event for an input
+  * 
+  * @param dev Our device structure
+  * @param in Input that changed
+  * @param level Level sampled after the edge
+  * @param now Timestamp of the interrupt
+  * @param wake Wake readers now; false if the caller defers the wakeup
   */
- static void gpio_led_configure_pin(void) {
-   unsigned int fsel_reg;
-   unsigned int fsel_bit;
-   unsigned int value;
+ static void gpio_led_in_event(struct gpio_led_dev *dev, struct gpio_led_input *in,
+                               bool level, u64 now, bool wake) {
+   struct gpio_led_event ev = {
+      .timestamp_ns = now,
+      .gpio = in->gpio,
+      .level = level,
+   };
+
+   if (kfifo_put(&in->events, ev)) {
+      this_cpu_inc(dev->stats->events);
+      if (wake)
+         wake_up_interruptible_poll(&in->wq, EPOLLIN | EPOLLRDNORM);
+   } else {
+      this_cpu_inc(dev->stats->events_dropped);
+   }
+   trace_gpio_led_edge(in->gpio, level);
+   gpio_led_chip_edge(in->gpio, level);
+ }
 
-   /* Calculate which FESEL register and bit position within that register */
-   fsel_reg = GPFSEL0 + ((GPIO_LED_PIN / 10) * 4);
-   fsel_bit = (GPIO_LED_PIN % 10) * 3;
+ /**
+  * @brief Simulated GPIO bank interrupt handler
+  * 
+  * Acknowledges the latched edges of our inputs in GPEDS, samples their
+  * levels and queues one timestamped event per edge, as the BCM GPIO
+  * controller does for real interrupts. Readers are woken from the
+  * simulator's wake_work, as this runs in hard interrupt context.
+  * 
+  * @param irq Interrupt number (unused)
+  * @param data Our device structure
+  * @return IRQ_HANDLED if any of our inputs had an edge, IRQ_NONE otherwise
+  */
+ static irqreturn_t gpio_led_irq(int irq, void *data) {
+   struct gpio_led_dev *dev = data;
+   u64 now = ktime_get_ns();
+   u64 pending, levels = 0;
+   u32 eds0, eds1;
+   unsigned int gpio;
 
-   /* Read current value */
-   value = readl(gpio_led_device.gpio_base + fsel_reg);
+   eds0 = gpio_led_readl(GPEDS0) & lower_32_bits(dev->in_mask);
+   eds1 = gpio_led_readl(GPEDS1) & upper_32_bits(dev->in_mask);
+   pending = ((u64)eds1 << 32) | eds0;
+   if (!pending)
+      return IRQ_NONE;
 
-   /* Clear the bits for this pin */
-   value &= ~(7 << fsel_bit);    // 7=> 111 (binary)
+   /* Acknowledge first so edges arriving from now on raise a new interrupt */
+   if (eds0) {
+      gpio_led_writel(eds0, GPEDS0);
+      levels |= gpio_led_readl(GPLEV0);
+   }
+   if (eds1) {
+      gpio_led_writel(eds1, GPEDS1);
+      levels |= (u64)gpio_led_readl(GPLEV1) << 32;
+   }
 
-   /* Set as output */
-   value |= (GPIO_FUNCTION_OUT << fsel_bit);
+   while (pending) {
+      gpio = __ffs64(pending);
+      pending &= pending - 1;
+      gpio_led_in_event(dev, &dev->inputs[dev->in_index[gpio]],
+                        levels & BIT_ULL(gpio), now, false);
+   }
+   irq_work_queue(&gpio_led_sim.wake_work);
+   return IRQ_HANDLED;
+ }
 
-   /* Write updated value */
-   writel(value, gpio_led_device.gpio_base + fsel_reg);
+ /**
+  * @brief Per-pin interrupt handler for inputs on real hardware
+  * 
+  * The BCM GPIO controller has already acknowledged the edge in GPEDS;
+  * only the level is sampled here.
+  * 
+  * @param irq Interrupt number of the input pin
+  * @param data The input
+  * @return IRQ_HANDLED
+  */
+ static irqreturn_t gpio_led_in_irq(int irq, void *data) {
+   struct gpio_led_input *in = data;
+   u64 now = ktime_get_ns();
+   u32 level;
 
-   pr_info("gpio_led_driver: Configured GPIO pin %d as output\n", GPIO_LED_PIN);
+   level = gpio_led_readl(GPLEV0 + GPIO_BANK_OFFSET(in->gpio)) & GPIO_BANK_BIT(in->gpio);
+   gpio_led_in_event(&gpio_led_device, in, level, now, true);
+   return IRQ_HANDLED;
  }
 
  /**
-  * @brief Turn the LED off by writing to GPCLR register
+  * @brief Handler for open() on /dev/gpio_in<N>
+  * 
+  * @param inode Pointer to inode structure of the device
+  * @param file Pointer to file structure for this open instance
+  * @return 0 on success, -ENODEV for an unknown minor
   */
- static void gpio_led_off(void) {
-   /* Clear the pin to turn LED off */
-   writel(1 << GPIO_LED_PIN, gpio_led_device.gpio_base + GPCLR0);
-   gpio_led_device.led_state = 0;
-   pr_info("gpio_led_driver: LED turned OFF\n");
+ static int gpio_led_in_open(struct inode *inode, struct file *file) {
+   unsigned int idx = iminor(inode) - MINOR(gpio_led_device.in_dev_num);
+
+   if (idx >= gpio_led_device.nr_inputs)
+      return -ENODEV;
+
+   file->private_data = &gpio_led_device.inputs[idx];
+   return stream_open(inode, file);
  }
 
  /**
-  * @brief Turn the LED on by writing to GPSET register
+  * @brief Handler for read() on /dev/gpio_in<N>
+  * 
+  * Returns as many whole struct gpio_led_event as fit in the buffer,
+  * blocking until at least one is queued unless O_NONBLOCK is set.
+  * 
+  * @param file Pointer to file structure
+  * @param buf User space buffer to copy events to
+  * @param count Size of the buffer
+  * @param pos Unused, events are a stream
+  * @return Number of bytes read, or negative error code
   */
- static void gpio_led_on(void) {
-   /* Set the pin to turn LED on */
-   writel(1 << GPIO_LED_PIN, gpio_led_device.gpio_base + GPSET0);
-   gpio_led_device.led_state = 1;
-   pr_info("gpio_led_driver: LED turned ON\n");
+ static ssize_t gpio_led_in_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
+   struct gpio_led_input *in = file->private_data;
+   unsigned int copied;
+   int ret;
+
+   if (count < sizeof(struct gpio_led_event))
+      return -EINVAL;
+
+   if (mutex_lock_interruptible(&in->read_lock))
+      return -ERESTARTSYS;
+
+   while (kfifo_is_empty(&in->events)) {
+      mutex_unlock(&in->read_lock);
+
+      if (file->f_flags & O_NONBLOCK)
+         return -EAGAIN;
+      if (wait_event_interruptible(in->wq, !kfifo_is_empty(&in->events)))
+         return -ERESTARTSYS;
+      if (mutex_lock_interruptible(&in->read_lock))
+         return -ERESTARTSYS;
+   }
+
+   ret = kfifo_to_user(&in->events, buf, count, &copied);
+   mutex_unlock(&in->read_lock);
+
+   return ret ? ret : copied;
  }
 
  /**
-  * @brief Handler for device open() operation
+  * @brief Handler for poll() on /dev/gpio_in<N>
+  * 
+  * @param file Pointer to file structure
+  * @param wait Poll table
+  * @return EPOLLIN | EPOLLRDNORM when events are queued
+  */
+ static __poll_t gpio_led_in_poll(struct file *file, poll_table *wait) {
+   struct gpio_led_input *in = file->private_data;
+
+   poll_wait(file, &in->wq, wait);
+   return kfifo_is_empty(&in->events) ? 0 : EPOLLIN | EPOLLRDNORM;
+ }
+
+ /**
+  * @brief Handler for mmap() on /dev/gpio_bank
   * 
-  * Called when a process opens our device file
+  * Maps the GPIO register page uncached so privileged processes can drive
+  * pins with a single store to GPSET/GPCLR. The mapping is page granular,
+  * so it necessarily includes GPFSEL as well; it is therefore limited to
+  * CAP_SYS_RAWIO, and pin functions remain the driver's business. Stores
+  * through the mapping bypass the cached LED state, PWM and statistics.
   * 
-  * @param inode Pointer to inode structure of the device
-  * @param file Pointer to file structure for this open instance
-  * @return 0 on success
+  * @param file Pointer to file structure
+  * @param vma Memory area to map, one page at offset 0
+  * @return 0 on success, or negative error code
   */
- static int gpio_led_open(struct inode *inode, struct file *file) {
-   /* Store our device data in the file's private_data for later use */
-   file->private_data = &gpio_led_device;
+ static int gpio_led_bank_mmap(struct file *file, struct vm_area_struct *vma) {
+   /* There are no registers to map when simulated */
+   if (static_branch_unlikely(&gpio_led_sim_key))
+      return -ENODEV;
+   if (!capable(CAP_SYS_RAWIO))
+      return -EPERM;
+   if (vma->vm_pgoff || vma->vm_end - vma->vm_start != PAGE_SIZE)
+      return -EINVAL;
+   /* A private mapping would copy-on-write stores instead of reaching GPSET/GPCLR */
+   if (!(vma->vm_flags & VM_SHARED))
+      return -EINVAL;
 
-   /* Log the open operation */
-   pr_info("gpio_led_driver: Device openned\n");
-   return 0;
+   vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+   return io_remap_pfn_range(vma, vma->vm_start, BCM2837_GPIO_BASE >> PAGE_SHIFT,
+                             PAGE_SIZE, vma->vm_page_prot);
  }
 
  /**
- * @brief Handler for device close() operation
- *
- * Called when a process closes our device file.
- *
- * @param inode Pointer to inode structure of the device
- * @param file Pointer to file structure for this open instance
- * @return 0 on success
- */
- static int gpio_led_release(struct inode *inode, struct file *file) {
-   /* Log the close operation */
-   pr_info("gpio_led_driver: Device closed\n");
+  * @brief Show the summed statistics in debugfs
+  * 
+  * @param m seq_file to print to
+  * @param unused Unused
+  * @return 0
+  */
+ static int gpio_led_stats_show(struct seq_file *m, void *unused) {
+   struct gpio_led_stats sum = {0};
+   const struct gpio_led_stats *st;
+   int cpu;
+
+   /* Sum the per-CPU copies; values may be slightly stale */
+   for_each_possible_cpu(cpu) {
+      st = per_cpu_ptr(gpio_led_device.stats, cpu);
+      sum.reads += st->reads;
+      sum.writes += st->writes;
+      sum.read_bytes += st->read_bytes;
+      sum.write_bytes += st->write_bytes;
+      sum.led_on += st->led_on;
+      sum.led_off += st->led_off;
+      sum.efault += st->efault;
+      sum.erestartsys += st->erestartsys;
+      sum.lock_contended += st->lock_contended;
+      sum.lock_wait_ns += st->lock_wait_ns;
+      sum.events += st->events;
+      sum.events_dropped += st->events_dropped;
+      sum.cmds_queued += st->cmds_queued;
+      sum.cmds_coalesced += st->cmds_coalesced;
+   }
+
+   seq_printf(m, "reads: %llu\n", sum.reads);
+   seq_printf(m, "writes: %llu\n", sum.writes);
+   seq_printf(m, "read_bytes: %llu\n", sum.read_bytes);
+   seq_printf(m, "write_bytes: %llu\n", sum.write_bytes);
+   seq_printf(m, "led_on: %llu\n", sum.led_on);
+   seq_printf(m, "led_off: %llu\n", sum.led_off);
+   seq_printf(m, "efault: %llu\n", sum.efault);
+   seq_printf(m, "erestartsys: %llu\n", sum.erestartsys);
+   seq_printf(m, "lock_contended: %llu\n", sum.lock_contended);
+   seq_printf(m, "lock_wait_ns: %llu\n", sum.lock_wait_ns);
+   seq_printf(m, "events: %llu\n", sum.events);
+   seq_printf(m, "events_dropped: %llu\n", sum.events_dropped);
+   seq_printf(m, "cmds_queued: %llu\n", sum.cmds_queued);
+   seq_printf(m, "cmds_coalesced: %llu\n", sum.cmds_coalesced);
    return 0;
  }
+ DEFINE_SHOW_ATTRIBUTE(gpio_led_stats);
 
  /**
-  * @brief Handler for device read() operation
+  * @brief Handler for writes to the debugfs reset file
   * 
-  * Copies the current LED status to user space.
+  * Any write zeroes all counters. Excluding the PWM timer and interrupt
+  * handlers would mean disabling interrupts on every CPU, so an edge or
+  * LED transition counted during the reset may survive it instead.
   * 
   * @param file Pointer to file structure
-  * @param count Number of bytes to read
+  * @param buf User space buffer (ignored)
+  * @param count Number of bytes written
   * @param pos Current position in file
-  * @return Number of bytes read, or negative error code
+  * @return count
   */
- static ssize_t gpio_led_read(struct file *file, char __user *buf, size_t count, loff_t *pos) {
-   struct gpio_led_dev *dev = file->private_data;
-   char status[8];
-   size_t status_size;  
-   ssize_t ret = 0;
+ static ssize_t gpio_led_reset_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
+   int cpu;
 
-   /* Lock to protect against concurrent access */
-   if (mutex_lock_interruptible(&dev->lock)) {
-      return -ERESTARTSYS;
-   }
+   for_each_possible_cpu(cpu)
+      memset(per_cpu_ptr(gpio_led_device.stats, cpu), 0, sizeof(struct gpio_led_stats));
+   return count;
+ }
 
-   /* Only proceed if we haven't sent data yet */
-   if (*pos > 0) {
-    goto out;
+ /* File operations for the debugfs reset file */
+ static const struct file_operations gpio_led_reset_fops = {
+    .owner = THIS_MODULE,
+    .write = gpio_led_reset_write,
+ };
+
+ /**
+  * @brief Check the pins module parameter
+  * 
+  * Covers both output and input pins; a pin may only be used once. Inputs
+  * need the interrupt line unless the registers are simulated.
+  * 
+  * @return 0 if at least one output pin is given and every pin exists and
+  *         is listed once, -EINVAL otherwise
+  */
+ static int gpio_led_check_pins(void) {
+   u64 seen = 0;
+   int i;
+
+   if (nr_pins < 1) {
+      pr_err("gpio_led_driver: No GPIO pins given\n");
+      return -EINVAL;
    }
 
-   /* Generate status string */
-   sprintf(status, "LED=%d\n", dev->led_state);
-   status_size = strlen(status);
+   for (i = 0; i < nr_pins; i++) {
+      if (pins[i] >= GPIO_MAX_PINS) {
+         pr_err("gpio_led_driver: Invalid GPIO pin %u\n", pins[i]);
+         return -EINVAL;
+      }
+      if (seen & BIT_ULL(pins[i])) {
+         pr_err("gpio_led_driver: GPIO pin %u listed twice\n", pins[i]);
+         return -EINVAL;
+      }
+      seen |= BIT_ULL(pins[i]);
+   }
 
-   /* Only copy up to the user's requested amount */
-   if (count < status_size) {
-      status_size = count;
+   for (i = 0; i < nr_inputs; i++) {
+      if (input_pins[i] >= GPIO_MAX_PINS) {
+         pr_err("gpio_led_driver: Invalid GPIO pin %u\n", input_pins[i]);
+         return -EINVAL;
+      }
+      if (seen & BIT_ULL(input_pins[i])) {
+         pr_err("gpio_led_driver: GPIO pin %u listed twice\n", input_pins[i]);
+         return -EINVAL;
+      }
+      seen |= BIT_ULL(input_pins[i]);
    }
+   return 0;
+ }
 
-   /* Copy to user space */
-   if (copy_to_user(buf, status, status_size)) {
-      ret = -EFAULT;
-      goto out;
+ /**
+  * @brief Remove the first count device files
+  * 
+  * @param count Number of device files to remove
+  */
+ static void gpio_led_destroy_devices(unsigned int count) {
+   while (count--)
+      device_destroy(gpio_led_device.class, gpio_led_device.dev_num + count);
+ }
+
+ /**
+  * @brief Release the per-pin input IRQs
+  * 
+  * @param count Number of inputs whose IRQ was requested
+  */
+ static void gpio_led_in_irqs_free(unsigned int count) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+
+   while (count--)
+      free_irq(dev->inputs[count].irq, &dev->inputs[count]);
+   gpio_device_put(dev->bcm_gpio);
+   dev->bcm_gpio = NULL;
+ }
+
+ /**
+  * @brief Request a both-edges IRQ for every input from the BCM GPIO controller
+  * 
+  * The bank interrupt belongs to pinctrl-bcm2835, which demultiplexes it
+  * and acknowledges GPEDS itself, so the inputs use its per-pin IRQs and
+  * let it program GPREN/GPFEN from the trigger flags.
+  * 
+  * @return 0 on success, negative error code on failure
+  */
+ static int gpio_led_in_irqs_request(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   struct gpio_led_input *in;
+   struct gpio_desc *desc;
+   unsigned int i;
+   int ret;
+
+   dev->bcm_gpio = gpio_device_find_by_label(BCM_GPIO_LABEL);
+   if (!dev->bcm_gpio) {
+      pr_err("gpio_led_driver: GPIO controller %s not found\n", BCM_GPIO_LABEL);
+      return -ENODEV;
    }
 
-   /* Update position and return bytes read */
-   *pos += status_size;
-   ret = status_size;
+   for (i = 0; i < dev->nr_inputs; i++) {
+      in = &dev->inputs[i];
+      desc = gpio_device_get_desc(dev->bcm_gpio, in->gpio);
+      ret = IS_ERR(desc) ? PTR_ERR(desc) : gpiod_to_irq(desc);
+      if (ret < 0) {
+         pr_err("gpio_led_driver: No IRQ for GPIO %u\n", in->gpio);
+         goto fail;
+      }
+      in->irq = ret;
 
-out:
-   mutex_unlock(&dev->lock);
-   return ret;
+      ret = request_irq(in->irq, gpio_led_in_irq,
+                        IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING, IN_NAME, in);
+      if (ret) {
+         pr_err("gpio_led_driver: Failed to request IRQ %d for GPIO %u\n",
+                in->irq, in->gpio);
+         goto fail;
+      }
+   }
+   return 0;
+
+ fail:
+      gpio_led_in_irqs_free(i);
+      return ret;
  }
 
  /**
-  * @brief Handler for device driver write() operation
+  * @brief Set up input pins, their device files and their interrupts
   * 
-  * Controls the LED based on user input.
-  * Write '1' to turn LED on, '0' to turn LED off.
+  * Must be called once the class exists and the registers are mapped.
   * 
-  * @param file Pointer to file structure
-  * @param buf User space buffer to copy data from
-  * @param count Number of bytes to write
-  * @param pos Current position in file
-  * @return Number of bytes written, or negative error code
+  * @return 0 on success (or without input pins), negative error code on failure
   */
- static ssize_t gpio_led_write(struct file *file, const char __user *buf, size_t count, loff_t *pos) {
-   struct gpio_led_dev *dev = file->private_data;
-   char cmd[8];
-   ssize_t ret = 0;
+ static int gpio_led_inputs_init(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   u64 fsel_masks[GPIO_LED_FUNC_COUNT] = {0};
+   struct gpio_led_input *in;
+   unsigned int i;
+   int ret;
 
-   /* Check for valid data */
-   if (count < 1) {
-      return -EINVAL;
+   if (!nr_inputs)
+      return 0;
+
+   dev->nr_inputs = nr_inputs;
+   dev->inputs = kcalloc(nr_inputs, sizeof(*dev->inputs), GFP_KERNEL);
+   if (!dev->inputs)
+      return -ENOMEM;
+
+   for (i = 0; i < dev->nr_inputs; i++) {
+      in = &dev->inputs[i];
+      in->gpio = input_pins[i];
+      INIT_KFIFO(in->events);
+      init_waitqueue_head(&in->wq);
+      mutex_init(&in->read_lock);
+      dev->in_mask |= BIT_ULL(in->gpio);
+      dev->in_index[in->gpio] = i;
    }
-   
-   /* Truncate input to prevent buffer overflow */
-   if (count > sizeof(cmd) - 1) {
-      count = sizeof(cmd) - 1;
+
+   /* Switch all inputs with one write per GPFSEL register */
+   fsel_masks[GPIO_FUNCTION_IN] = dev->in_mask;
+   gpio_led_set_functions(fsel_masks);
+
+   ret = alloc_chrdev_region(&dev->in_dev_num, 0, dev->nr_inputs, IN_NAME);
+   if (ret < 0) {
+      pr_err("gpio_led_driver: Failed to allocate input device numbers\n");
+      goto fail_alloc_chrdev;
    }
-   
-   /* Lock to protect against concurrent accesss */
-   if (mutex_lock_interruptible(&dev->lock)) {
-      return -ERESTARTSYS;
+
+   cdev_init(&dev->in_cdev, &gpio_led_in_fops);
+   dev->in_cdev.owner = THIS_MODULE;
+   ret = cdev_add(&dev->in_cdev, dev->in_dev_num, dev->nr_inputs);
+   if (ret < 0) {
+      pr_err("gpio_led_driver: Failed to add input character device\n");
+      goto fail_cdev_add;
    }
 
-   /* Copy command from user space */
-   if (copy_from_user(cmd, buf, count)) {
-      ret = -EFAULT;
-      goto out;
+   /* Create a device file /dev/gpio_in<N> for each input */
+   for (i = 0; i < dev->nr_inputs; i++) {
+      in = &dev->inputs[i];
+      in->device = device_create(dev->class, NULL, dev->in_dev_num + i, NULL,
+                                 IN_NAME "%u", in->gpio);
+      if (IS_ERR(in->device)) {
+         pr_err("gpio_led_driver: Failed to create input device file\n");
+         ret = PTR_ERR(in->device);
+         goto fail_device_create;
+      }
    }
 
-   /* Null-terminate the command */
-   cmd[count] = '\0';
+   /* The simulator latches edges itself and raises its interrupt through irq_work */
+   if (static_branch_unlikely(&gpio_led_sim_key)) {
+      gpio_led_set_edges(dev->in_mask, true);
+      return 0;
+   }
 
-   /* Process the commnad */
-   switch (cmd[0]) {
-    case LED_CMD_ON:
-        gpio_led_on();
-        break;
-    
-    case LED_CMD_OFF:
-        gpio_led_off();
-        break;
+   ret = gpio_led_in_irqs_request();
+   if (ret)
+      goto fail_device_create;
+   return 0;
 
-    default:
-        /* Store the input in our buffer for future read operations */
-        if (count > BUFFER_SIZE)
-            count = BUFFER_SIZE;
-            
-        memcpy(dev->buffer, cmd, count);
-        dev->buffer_size = count;
-        break;
-    }
+ fail_device_create:
+      while (i--)
+         device_destroy(dev->class, dev->in_dev_num + i);
+      cdev_del(&dev->in_cdev);
+ fail_cdev_add:
+      unregister_chrdev_region(dev->in_dev_num, dev->nr_inputs);
+ fail_alloc_chrdev:
+      kfree(dev->inputs);
+      dev->nr_inputs = 0;
+      return ret;
+ }
 
-    /* Return the number of bytes processed */
-    ret = count;
-    
-out:
-    mutex_unlock(&dev->lock);
-    return ret;
+ /**
+  * @brief Tear down what gpio_led_inputs_init() set up
+  */
+ static void gpio_led_inputs_exit(void) {
+   struct gpio_led_dev *dev = &gpio_led_device;
+   unsigned int i;
+
+   if (!dev->nr_inputs)
+      return;
+
+   /* Quiesce the hardware before the handlers go away */
+   if (static_branch_unlikely(&gpio_led_sim_key)) {
+      gpio_led_set_edges(dev->in_mask, false);
+      irq_work_sync(&gpio_led_sim.irq_work);
+      irq_work_sync(&gpio_led_sim.wake_work);
+   } else {
+      gpio_led_in_irqs_free(dev->nr_inputs);
+   }
+
+   for (i = 0; i < dev->nr_inputs; i++)
+      device_destroy(dev->class, dev->in_dev_num + i);
+   cdev_del(&dev->in_cdev);
+   unregister_chrdev_region(dev->in_dev_num, dev->nr_inputs);
+   kfree(dev->inputs);
  }
 
  /**
@@ -285,37 +2534,97 @@ out:
   * @return 0 on success, negative error code on failure
   */
  static int __init gpio_led_init(void) {
+   u64 fsel_masks[GPIO_LED_FUNC_COUNT] = {0};
+   struct gpio_led_pin *pin;
+   unsigned int i;
    int ret;
    
    /* Initialize device structure */
    memset(&gpio_led_device, 0, sizeof(struct gpio_led_dev));
 
-   /* Initialize mutex */
-   mutex_init(&gpio_led_device.lock);
+   /* Select the register backend */
+   if (sysfs_streq(backend, "sim")) {
+      raw_spin_lock_init(&gpio_led_sim.lock);
+      gpio_led_sim.irq_work = IRQ_WORK_INIT_HARD(gpio_led_sim_irq);
+      init_irq_work(&gpio_led_sim.wake_work, gpio_led_sim_wake);
+      static_branch_enable(&gpio_led_sim_key);
+   } else if (!sysfs_streq(backend, "hw")) {
+      pr_err("gpio_led_driver: Unknown backend %s\n", backend);
+      return -EINVAL;
+   }
+
+   /* Validate the requested pins before touching any hardware */
+   ret = gpio_led_check_pins();
+   if (ret)
+      return ret;
+
+   if (pwm_period_us < PWM_PERIOD_MIN_US || pwm_period_us > PWM_PERIOD_MAX_US) {
+      pr_err("gpio_led_driver: Invalid PWM period %u us\n", pwm_period_us);
+      return -EINVAL;
+   }
+
+   /* Initialize locks and the sequencer timer */
+   mutex_init(&gpio_led_device.seq_lock);
+   raw_spin_lock_init(&gpio_led_device.hw_lock);
+   raw_spin_lock_init(&gpio_led_device.fsel_lock);
+   hrtimer_init(&gpio_led_device.seq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_HARD);
+   gpio_led_device.seq_timer.function = gpio_led_seq_fn;
+   hrtimer_init(&gpio_led_device.pwm_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_HARD);
+   gpio_led_device.pwm_timer.function = gpio_led_pwm_fn;
+   init_llist_head(&gpio_led_device.cmd_list);
+   init_waitqueue_head(&gpio_led_device.cmd_wq);
+   INIT_WORK(&gpio_led_device.cmd_work, gpio_led_cmd_work);
 
-   /* Allocate memory buffer for our device */
-   gpio_led_device.buffer = kzalloc(BUFFER_SIZE, GFP_KERNEL);
-   if (!gpio_led_device.buffer) {
+   /* Allocate per-CPU statistics */
+   gpio_led_device.stats = alloc_percpu(struct gpio_led_stats);
+   if (!gpio_led_device.stats) {
       pr_err("gpio_led_driver: Failed to allocate memory\n");
+      return -ENOMEM;
+   }
+
+   /* Cache for commands in queued mode */
+   gpio_led_cmd_cache = KMEM_CACHE(gpio_led_cmd, 0);
+   if (!gpio_led_cmd_cache) {
+      pr_err("gpio_led_driver: Failed to create command cache\n");
       ret = -ENOMEM;
+      goto fail_cmd_cache;
    }
 
-   /* Map GPIO register */
-   gpio_led_device.gpio_base = ioremap(BCM2837_GPIO_BASE, GPIO_REG_SIZE);
-   if (!gpio_led_device.gpio_base) {
-      pr_err("gpio_led_driver: Failed to map GPIO registers\n");
+   /* Allocate per-pin state */
+   gpio_led_device.nr_pins = nr_pins;
+   gpio_led_device.pins = kcalloc(nr_pins, sizeof(*gpio_led_device.pins), GFP_KERNEL);
+   if (!gpio_led_device.pins) {
+      pr_err("gpio_led_driver: Failed to allocate memory\n");
       ret = -ENOMEM;
-      goto fail_ioremap;
+      goto fail_pins;
    }
 
-   /* Configure GPIO pin for LED control */
-   gpio_led_configure_pin();
+   /* Map GPIO register once for all pins (nothing to map when simulated) */
+   if (!static_branch_unlikely(&gpio_led_sim_key)) {
+      gpio_led_device.gpio_base = ioremap(BCM2837_GPIO_BASE, GPIO_REG_SIZE);
+      if (!gpio_led_device.gpio_base) {
+         pr_err("gpio_led_driver: Failed to map GPIO registers\n");
+         ret = -ENOMEM;
+         goto fail_ioremap;
+      }
+   }
+
+   /* Configure every GPIO pin for LED control and turn it off at starup */
+   for (i = 0; i < gpio_led_device.nr_pins; i++) {
+      pin = &gpio_led_device.pins[i];
+      pin->gpio = pins[i];
+      gpio_led_device.pin_mask |= BIT_ULL(pin->gpio);
+   }
 
-   /* Initialize LED state (turn off at starup) */
-   gpio_led_off();
+   /* Latch the outputs low before enabling them, so no pin glitches high */
+   gpio_led_fsel_init();
+   gpio_led_set_multiple(0, gpio_led_device.pin_mask);
+   fsel_masks[GPIO_FUNCTION_OUT] = gpio_led_device.pin_mask;
+   gpio_led_set_functions(fsel_masks);
+   pr_info("gpio_led_driver: Configured %u GPIO pins as output\n", gpio_led_device.nr_pins);
 
-   /* Allocat a device number (major and minor) */
-   ret = alloc_chrdev_region(&gpio_led_device.dev_num, 0, 1, DRIVER_NAME);
+   /* Allocat a device number (major, one minor per pin and one for the bank) */
+   ret = alloc_chrdev_region(&gpio_led_device.dev_num, 0, gpio_led_device.nr_pins + 1, DRIVER_NAME);
    if (ret < 0) {
       pr_err("gpio_led_driver: Failed to allocate device number\n");
       goto fail_alloc_chrdev;
@@ -329,13 +2638,18 @@ out:
       goto fail_class_create;
    }
 
-   /* Create a device file in /dev */
-   gpio_led_device.device = device_create(gpio_led_device.class, NULL, 
-                               gpio_led_device.dev_num, NULL, DRIVER_NAME);
-   if (IS_ERR(gpio_led_device.device)) {
-      pr_err("gpio_led_driver: Failed to create device file\n");
-      ret = PTR_ERR(gpio_led_device.device);
-      goto fail_device_create;
+   /* Create a device file /dev/gpio_led<N> for each pin */
+   for (i = 0; i < gpio_led_device.nr_pins; i++) {
+      pin = &gpio_led_device.pins[i];
+      pin->device = device_create(gpio_led_device.class, NULL, 
+                                  gpio_led_device.dev_num + i, NULL,
+                                  DRIVER_NAME "%u", pin->gpio);
+      if (IS_ERR(pin->device)) {
+         pr_err("gpio_led_driver: Failed to create device file\n");
+         ret = PTR_ERR(pin->device);
+         gpio_led_destroy_devices(i);
+         goto fail_device_create;
+      }
    }
 
    /* Initialize character device sructure with our file operations */
@@ -343,31 +2657,89 @@ out:
    gpio_led_device.cdev.owner = THIS_MODULE;
 
    /* Add character device to the system */
-   ret = cdev_add(&gpio_led_device.cdev, gpio_led_device.dev_num, 1);
+   ret = cdev_add(&gpio_led_device.cdev, gpio_led_device.dev_num, gpio_led_device.nr_pins);
    if (ret < 0) {
       pr_err("gpio_led_driver: Failed to add character device\n");
       goto fail_cdev_add;
    }
+
+   /* The bank device uses the minor after the last pin */
+   cdev_init(&gpio_led_device.bank_cdev, &gpio_led_bank_fops);
+   gpio_led_device.bank_cdev.owner = THIS_MODULE;
+
+   ret = cdev_add(&gpio_led_device.bank_cdev,
+                  gpio_led_device.dev_num + gpio_led_device.nr_pins, 1);
+   if (ret < 0) {
+      pr_err("gpio_led_driver: Failed to add bank character device\n");
+      goto fail_bank_cdev_add;
+   }
+
+   gpio_led_device.bank_device = device_create(gpio_led_device.class, NULL,
+                                    gpio_led_device.dev_num + gpio_led_device.nr_pins,
+                                    NULL, BANK_NAME);
+   if (IS_ERR(gpio_led_device.bank_device)) {
+      pr_err("gpio_led_driver: Failed to create bank device file\n");
+      ret = PTR_ERR(gpio_led_device.bank_device);
+      goto fail_bank_device_create;
+   }
+
+   /* Input pins with edge interrupts */
+   ret = gpio_led_inputs_init();
+   if (ret)
+      goto fail_inputs;
+
+   /* Expose the pins through gpiolib and the GPIO character device */
+   ret = gpio_led_chip_init();
+   if (ret) {
+      pr_err("gpio_led_driver: Failed to register gpio_chip\n");
+      goto fail_chip;
+   }
    
+   /* Export statistics in /sys/kernel/debug/gpio_led/ (failures are not fatal) */
+   gpio_led_device.debugfs = debugfs_create_dir(DRIVER_NAME, NULL);
+   debugfs_create_file("stats", 0444, gpio_led_device.debugfs, NULL, &gpio_led_stats_fops);
+   debugfs_create_file("reset", 0200, gpio_led_device.debugfs, NULL, &gpio_led_reset_fops);
+   if (static_branch_unlikely(&gpio_led_sim_key))
+      debugfs_create_file("sim_input", 0200, gpio_led_device.debugfs, NULL,
+                          &gpio_led_sim_input_fops);
+
    /* Log sucessful initalization */
-   pr_info("gpio_led_driver: Initialized with major = %d, minor = %d\n", 
-            MAJOR(gpio_led_device.dev_num), MINOR(gpio_led_device.dev_num));
-   pr_info("gpio_led_driver: Created device file: /dev/%s\n", DRIVER_NAME);
+   pr_info("gpio_led_driver: Initialized with major = %d, minor = %d, backend = %s\n", 
+            MAJOR(gpio_led_device.dev_num), MINOR(gpio_led_device.dev_num), backend);
+   pr_info("gpio_led_driver: Created %u device files /dev/%s<pin>\n",
+           gpio_led_device.nr_pins, DRIVER_NAME);
+   pr_info("gpio_led_driver: Created device file: /dev/%s\n", BANK_NAME);
+   if (gpio_led_device.nr_inputs)
+      pr_info("gpio_led_driver: Created %u device files /dev/%s<pin>\n",
+              gpio_led_device.nr_inputs, IN_NAME);
    pr_info("gpio_led_driver: Write '1' to turn LED on, '0' to turn LED off\n");
 
    return 0;
 
  /* Error handling with cleanup */
+ fail_chip:
+      gpio_led_inputs_exit();
+ fail_inputs:
+      device_destroy(gpio_led_device.class, gpio_led_device.dev_num + gpio_led_device.nr_pins);
+ fail_bank_device_create:
+      cdev_del(&gpio_led_device.bank_cdev);
+ fail_bank_cdev_add:
+      cdev_del(&gpio_led_device.cdev);
  fail_cdev_add:
-      device_destroy(gpio_led_device.class, gpio_led_device.dev_num);
+      gpio_led_destroy_devices(gpio_led_device.nr_pins);
  fail_device_create:
       class_destroy(gpio_led_device.class);  
  fail_class_create:
-      unregister_chrdev_region(gpio_led_device.dev_num, 1);
+      unregister_chrdev_region(gpio_led_device.dev_num, gpio_led_device.nr_pins + 1);
  fail_alloc_chrdev:
-      iounmap(gpio_led_device.gpio_base);
+      if (gpio_led_device.gpio_base)
+         iounmap(gpio_led_device.gpio_base);
  fail_ioremap:
-      kfree(gpio_led_device.buffer);
+      kfree(gpio_led_device.pins);
+ fail_pins:
+      kmem_cache_destroy(gpio_led_cmd_cache);
+ fail_cmd_cache:
+      free_percpu(gpio_led_device.stats);
 
   return ret;
  }
@@ -378,26 +2750,52 @@ out:
   * Called when the module is unloaded. Release all resources. 
   */
  static void __exit gpio_led_exit(void) {
-   /* Turn off LED when unloading */
-   gpio_led_off();
+   unsigned int i;
+
+   /* Remove the statistics files */
+   debugfs_remove_recursive(gpio_led_device.debugfs);
+
+   /* Remove the gpio_chip while the input interrupt still exists */
+   gpiochip_remove(&gpio_led_device.chip);
+
+   /* Stop input interrupts and remove the input devices */
+   gpio_led_inputs_exit();
+
+   /* Apply queued commands; no writers are left to queue more */
+   gpio_led_sync();
+
+   /* Stop the sequencer and PWM before switching the pins off */
+   gpio_led_seq_stop();
+   gpio_led_pwm_stop();
+
+   /* Turn off every LED when unloading */
+   for (i = 0; i < gpio_led_device.nr_pins; i++)
+      gpio_led_off(&gpio_led_device.pins[i]);
    
+   /* Remove the bank device */
+   device_destroy(gpio_led_device.class, gpio_led_device.dev_num + gpio_led_device.nr_pins);
+   cdev_del(&gpio_led_device.bank_cdev);
+
    /* Remove character device from system */
    cdev_del(&gpio_led_device.cdev);
 
-   /* Remove device file */
-   device_destroy(gpio_led_device.class, gpio_led_device.dev_num);
+   /* Remove device files */
+   gpio_led_destroy_devices(gpio_led_device.nr_pins);
 
    /* Remove device file */
    class_destroy(gpio_led_device.class);
 
    /* Release device number */
-   unregister_chrdev_region(gpio_led_device.dev_num, 1);
+   unregister_chrdev_region(gpio_led_device.dev_num, gpio_led_device.nr_pins + 1);
 
    /* Unmap GPIO registers */
-   iounmap(gpio_led_device.gpio_base);
+   if (gpio_led_device.gpio_base)
+      iounmap(gpio_led_device.gpio_base);
     
-   /* Free the memory buffer */
-   kfree(gpio_led_device.buffer);
+   /* Free the pin state and statistics */
+   kfree(gpio_led_device.pins);
+   kmem_cache_destroy(gpio_led_cmd_cache);
+   free_percpu(gpio_led_device.stats);
     
    /* Log successful unloading */
    pr_info("gpio_led_driver: Module unloaded\n");
@@ -0,0 +1,163 @@
+/**
+ * @file gpio_led_driver.h
+ * @brief Definitions shared between gpio_led_driver and user space
+ *
+ * This header only uses types from <linux/types.h> and <linux/ioctl.h>
+ * so it can be included by both the kernel module and test applications.
+ */
+
+ #ifndef GPIO_LED_DRIVER_H
+ #define GPIO_LED_DRIVER_H
+
+ #include <linux/types.h>     /* For __u32, __u64 */
+ #include <linux/ioctl.h>     /* For _IO/_IOW */
+
+ /* ioctl magic number for /dev/gpio_bank */
+ #define GPIO_LED_IOC_MAGIC      'g'
+
+ /*
+  * Register offsets within the page mapped by mmap() on /dev/gpio_bank.
+  * Writing a mask to SET/CLR drives those pins high/low; LEV reads the
+  * levels. Bank 0 is GPIO 0..31, bank 1 is GPIO 32..53.
+  */
+ #define GPIO_LED_MMAP_SET0      0x1C
+ #define GPIO_LED_MMAP_SET1      0x20
+ #define GPIO_LED_MMAP_CLR0      0x28
+ #define GPIO_LED_MMAP_CLR1      0x2C
+ #define GPIO_LED_MMAP_LEV0      0x34
+ #define GPIO_LED_MMAP_LEV1      0x38
+
+ /**
+  * Pins to drive high and low in one update. Bit N stands for BCM GPIO N;
+  * only pins managed by the driver may be given, and a pin may not be in
+  * both masks. Writing this structure to /dev/gpio_bank has the same
+  * effect as GPIO_LED_IOC_SET_CLEAR.
+  */
+ struct gpio_led_mask {
+    __u64 set;       /* Pins to drive high (GPSET0/GPSET1) */
+    __u64 clear;     /* Pins to drive low (GPCLR0/GPCLR1) */
+ };
+
+ /**
+  * One step of a sequence played back by the driver: drive the pins in
+  * mask to level, then wait duration_ns before the next step.
+  */
+ struct gpio_led_step {
+    __u64 mask;         /* Managed pins to update, bit N for GPIO N */
+    __u32 level;        /* 1 = drive high, 0 = drive low */
+    __u32 reserved;     /* Must be zero */
+    __u64 duration_ns;  /* Hold time, at least GPIO_LED_SEQ_MIN_NS */
+ };
+
+ /* Limits for GPIO_LED_IOC_SEQ_START */
+ #define GPIO_LED_SEQ_MAX        4096    /* Maximum number of steps */
+ #define GPIO_LED_SEQ_MIN_NS     10000   /* Shortest step duration (10 us) */
+
+ /* Flags for struct gpio_led_seq */
+ #define GPIO_LED_SEQ_LOOP       (1U << 0) /* Restart after the last step */
+
+ /**
+  * Header of a GPIO_LED_IOC_SEQ_START request. Starting a sequence
+  * replaces the one currently playing.
+  */
+ struct gpio_led_seq {
+    __u64 steps;     /* Pointer to an array of struct gpio_led_step */
+    __u32 count;     /* Number of steps (1..GPIO_LED_SEQ_MAX) */
+    __u32 flags;     /* GPIO_LED_SEQ_* */
+ };
+
+ /**
+  * Edge event read from /dev/gpio_in<N>. read() returns whole events only.
+  */
+ struct gpio_led_event {
+    __u64 timestamp_ns;  /* CLOCK_MONOTONIC time of the interrupt */
+    __u32 gpio;          /* BCM GPIO number */
+    __u32 level;         /* Pin level sampled in the interrupt handler */
+ };
+
+ /* Flags for struct gpio_led_state */
+ #define GPIO_LED_STATE_PWM      (1U << 0) /* Pin is dimmed by the PWM engine */
+
+ /**
+  * Binary status of one pin, returned by GPIO_LED_IOC_GET_STATE on
+  * /dev/gpio_led<N>. The text equivalent is read() returning "LED=<level>".
+  */
+ struct gpio_led_state {
+    __u32 gpio;      /* BCM GPIO number */
+    __u32 level;     /* Last level written (1 while dimmed) */
+    __u32 duty;      /* PWM duty in per mille when GPIO_LED_STATE_PWM is set */
+    __u32 flags;     /* GPIO_LED_STATE_* */
+ };
+
+ /**
+  * Snapshot of the hardware pin levels, returned by GPIO_LED_IOC_GET_LEVELS
+  * on /dev/gpio_bank. read() on /dev/gpio_bank returns the same snapshot as
+  * text, e.g. "17=1 18=0 22=1".
+  */
+ struct gpio_led_levels {
+    __u64 levels;        /* GPLEV0/GPLEV1 bits of the managed pins */
+    __u64 mask;          /* Managed pins, outputs and inputs */
+    __u64 timestamp_ns;  /* CLOCK_MONOTONIC time of the snapshot */
+ };
+
+ /* Pin functions for struct gpio_led_fsel, as encoded in GPFSEL */
+ #define GPIO_LED_FUNC_IN        0
+ #define GPIO_LED_FUNC_OUT       1
+ #define GPIO_LED_FUNC_ALT0      4
+ #define GPIO_LED_FUNC_ALT1      5
+ #define GPIO_LED_FUNC_ALT2      6
+ #define GPIO_LED_FUNC_ALT3      7
+ #define GPIO_LED_FUNC_ALT4      3
+ #define GPIO_LED_FUNC_ALT5      2
+ #define GPIO_LED_FUNC_COUNT     8
+
+ /**
+  * Bulk pin function change for GPIO_LED_IOC_SET_FUNCTIONS. mask[f] holds
+  * the managed pins to switch to function f (bit N for GPIO N); a pin may
+  * appear in at most one mask. Each affected GPFSEL register is re-read
+  * and written once, so other pins in it keep their current function.
+  */
+ struct gpio_led_fsel {
+    __u64 mask[GPIO_LED_FUNC_COUNT];
+ };
+
+ /* Full scale of struct gpio_led_pwm duty, in per mille of the period */
+ #define GPIO_LED_PWM_MAX        1000
+
+ /**
+  * Brightness of one pin driven by the software PWM engine. Duty 0 and
+  * GPIO_LED_PWM_MAX hold the pin low or high without any timer activity.
+  */
+ struct gpio_led_pwm {
+    __u32 gpio;      /* Managed BCM GPIO number */
+    __u32 duty;      /* High time, 0..GPIO_LED_PWM_MAX per mille of the period */
+ };
+
+ /* Drive several pins with at most one MMIO write per register */
+ #define GPIO_LED_IOC_SET_CLEAR  _IOW(GPIO_LED_IOC_MAGIC, 1, struct gpio_led_mask)
+ /* Upload a sequence and start playing it from a kernel timer */
+ #define GPIO_LED_IOC_SEQ_START  _IOW(GPIO_LED_IOC_MAGIC, 2, struct gpio_led_seq)
+ /* Stop the sequence; pins keep their current levels */
+ #define GPIO_LED_IOC_SEQ_STOP   _IO(GPIO_LED_IOC_MAGIC, 3)
+ /* Set the PWM duty cycle of one pin */
+ #define GPIO_LED_IOC_SET_PWM    _IOW(GPIO_LED_IOC_MAGIC, 4, struct gpio_led_pwm)
+ /* Get the state of the pin behind a /dev/gpio_led<N> file */
+ #define GPIO_LED_IOC_GET_STATE  _IOR(GPIO_LED_IOC_MAGIC, 5, struct gpio_led_state)
+ /* Snapshot GPLEV0/GPLEV1 for all managed pins */
+ #define GPIO_LED_IOC_GET_LEVELS _IOR(GPIO_LED_IOC_MAGIC, 6, struct gpio_led_levels)
+ /* Change the function of many pins at once */
+ #define GPIO_LED_IOC_SET_FUNCTIONS _IOW(GPIO_LED_IOC_MAGIC, 7, struct gpio_led_fsel)
+ /* Wait until all queued writes have reached the hardware (same as fsync) */
+ #define GPIO_LED_IOC_SYNC       _IO(GPIO_LED_IOC_MAGIC, 8)
+
+ #ifdef __KERNEL__
+ /*
+  * In-kernel API exported by gpio_led_driver. None of these sleep, so
+  * they may be called from any context. Only managed pins are accepted.
+  */
+ int gpio_led_set_multiple(u64 set, u64 clear);
+ int gpio_led_set_value(unsigned int gpio, int value);
+ int gpio_led_get_value(unsigned int gpio);
+ #endif /* __KERNEL__ */
+
+ #endif /* GPIO_LED_DRIVER_H */
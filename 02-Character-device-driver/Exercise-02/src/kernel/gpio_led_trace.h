@@ -0,0 +1,160 @@
+/**
+ * @file gpio_led_trace.h
+ * @brief Tracepoints for gpio_led_driver
+ *
+ * Enable the events with ftrace or perf, for example:
+ *   echo 1 > /sys/kernel/tracing/events/gpio_led/enable
+ */
+
+ #undef TRACE_SYSTEM
+ #define TRACE_SYSTEM gpio_led
+
+ #if !defined(_GPIO_LED_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+ #define _GPIO_LED_TRACE_H
+
+ #include <linux/tracepoint.h>
+
+ /* open() and release() of the device file */
+ DECLARE_EVENT_CLASS(gpio_led_file,
+    TP_PROTO(unsigned int pin),
+    TP_ARGS(pin),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, pin)
+    ),
+
+    TP_fast_assign(
+        __entry->pin = pin;
+    ),
+
+    TP_printk("pin=%u", __entry->pin)
+ );
+
+ DEFINE_EVENT(gpio_led_file, gpio_led_open,
+    TP_PROTO(unsigned int pin),
+    TP_ARGS(pin)
+ );
+
+ DEFINE_EVENT(gpio_led_file, gpio_led_release,
+    TP_PROTO(unsigned int pin),
+    TP_ARGS(pin)
+ );
+
+ /*
+  * Completed read or write, with its size, result and latency. The
+  * latency is only measured while the event is enabled; otherwise the
+  * file handlers pay a single static branch.
+  */
+ DECLARE_EVENT_CLASS(gpio_led_io,
+    TP_PROTO(unsigned int pin, size_t count, ssize_t ret, u64 latency_ns),
+    TP_ARGS(pin, count, ret, latency_ns),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, pin)
+        __field(size_t, count)
+        __field(ssize_t, ret)
+        __field(u64, latency_ns)
+    ),
+
+    TP_fast_assign(
+        __entry->pin = pin;
+        __entry->count = count;
+        __entry->ret = ret;
+        __entry->latency_ns = latency_ns;
+    ),
+
+    TP_printk("pin=%u count=%zu ret=%zd latency=%llu ns",
+              __entry->pin, __entry->count, __entry->ret,
+              __entry->latency_ns)
+ );
+
+ DEFINE_EVENT(gpio_led_io, gpio_led_read,
+    TP_PROTO(unsigned int pin, size_t count, ssize_t ret, u64 latency_ns),
+    TP_ARGS(pin, count, ret, latency_ns)
+ );
+
+ DEFINE_EVENT(gpio_led_io, gpio_led_write,
+    TP_PROTO(unsigned int pin, size_t count, ssize_t ret, u64 latency_ns),
+    TP_ARGS(pin, count, ret, latency_ns)
+ );
+
+ /* LED output transition written to GPSET/GPCLR */
+ TRACE_EVENT(gpio_led_set,
+    TP_PROTO(unsigned int pin, int value),
+    TP_ARGS(pin, value),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, pin)
+        __field(int, value)
+    ),
+
+    TP_fast_assign(
+        __entry->pin = pin;
+        __entry->value = value;
+    ),
+
+    TP_printk("pin=%u value=%d", __entry->pin, __entry->value)
+ );
+
+ /* Edge detected on an input pin */
+ TRACE_EVENT(gpio_led_edge,
+    TP_PROTO(unsigned int pin, unsigned int level),
+    TP_ARGS(pin, level),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, pin)
+        __field(unsigned int, level)
+    ),
+
+    TP_fast_assign(
+        __entry->pin = pin;
+        __entry->level = level;
+    ),
+
+    TP_printk("pin=%u level=%u", __entry->pin, __entry->level)
+ );
+
+ /* PWM duty cycle change of one pin */
+ TRACE_EVENT(gpio_led_pwm,
+    TP_PROTO(unsigned int pin, unsigned int duty),
+    TP_ARGS(pin, duty),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, pin)
+        __field(unsigned int, duty)
+    ),
+
+    TP_fast_assign(
+        __entry->pin = pin;
+        __entry->duty = duty;
+    ),
+
+    TP_printk("pin=%u duty=%u", __entry->pin, __entry->duty)
+ );
+
+ /* Bulk update of several pins through /dev/gpio_bank */
+ TRACE_EVENT(gpio_led_set_mask,
+    TP_PROTO(u64 set, u64 clear),
+    TP_ARGS(set, clear),
+
+    TP_STRUCT__entry(
+        __field(u64, set)
+        __field(u64, clear)
+    ),
+
+    TP_fast_assign(
+        __entry->set = set;
+        __entry->clear = clear;
+    ),
+
+    TP_printk("set=%#llx clear=%#llx", __entry->set, __entry->clear)
+ );
+
+ #endif /* _GPIO_LED_TRACE_H */
+
+ /* This part must be outside the include guard */
+ #undef TRACE_INCLUDE_PATH
+ #define TRACE_INCLUDE_PATH .
+ #undef TRACE_INCLUDE_FILE
+ #define TRACE_INCLUDE_FILE gpio_led_trace
+ #include <trace/define_trace.h>
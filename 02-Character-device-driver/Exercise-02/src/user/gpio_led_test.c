@@ -4,6 +4,8 @@
  * 
  * This application demonstrates how to use the GPIO LED driver
  * by opening the device file and writing commands to control the LED.
+ * The selftest command checks /dev/gpio_bank masks, GPIO_LED_IOC_GET_LEVELS,
+ * PWM and the sequencer; it runs on hardware or with backend=sim.
  */
 
  #include <stdio.h>
@@ -12,10 +14,16 @@
  #include <unistd.h>
  #include <fcntl.h>
  #include <errno.h>
+ #include <stdint.h>
+ #include <sys/ioctl.h>
+
+ #include "../kernel/gpio_led_driver.h" /* For GPIO_LED_IOC_* */
 
  /* Constants */
- #define DEVICE_PATH     "/dev/gpio_led"   /* Path to the device file */
+ #define DEVICE_PATH     "/dev/gpio_led17" /* Default device file (GPIO 17) */
+ #define BANK_PATH       "/dev/gpio_bank"  /* Default device for selftest */
  #define BUFFER_SIZE     64                /* Size of our read buffer */
+ #define SEQ_STEP_NS     20000000          /* Sequencer step length (20 ms) */
 
  /**
  * @brief Print usage instructions
@@ -23,12 +31,14 @@
  * @param program_name Name of the program
  */
  static void print_usage(const char *program_name) {
-     printf("Usage: %s COMMAND\n\n", program_name);
+     printf("Usage: %s COMMAND [DEVICE]\n\n", program_name);
      printf("Commands:\n");
      printf("  on       Turn the LED on\n");
      printf("  off      Turn the LED off\n");
      printf("  status   Read the current LED status\n");
-     printf("\nExample: %s on\n", program_name);
+     printf("  selftest Check bank masks, levels, PWM and the sequencer\n");
+     printf("\nDEVICE defaults to %s (%s for selftest)\n", DEVICE_PATH, BANK_PATH);
+     printf("\nExample: %s on /dev/gpio_led18\n", program_name);
  }
  
  /**
@@ -100,20 +110,214 @@
     return 0;
  }
 
+ /**
+ * @brief Compare the output levels with the expected bitmap
+ * @param fd File descriptor for /dev/gpio_bank
+ * @param outputs Output pins to compare
+ * @param expected Expected levels of those pins
+ * @param what Description of the check
+ * @return 0 if they match, -1 otherwise
+ */
+ static int check_levels(int fd, uint64_t outputs, uint64_t expected, const char *what) {
+    struct gpio_led_levels levels;
+
+    if (ioctl(fd, GPIO_LED_IOC_GET_LEVELS, &levels) < 0) {
+        perror("Error reading levels");
+        return -1;
+    }
+
+    if ((levels.levels & outputs) != expected) {
+        printf("FAIL %s: levels 0x%016llx, expected 0x%016llx\n", what,
+               (unsigned long long)(levels.levels & outputs),
+               (unsigned long long)expected);
+        return -1;
+    }
+
+    printf("ok   %s\n", what);
+    return 0;
+ }
+
+ /**
+ * @brief Write masks to /dev/gpio_bank
+ * @param fd File descriptor for /dev/gpio_bank
+ * @param masks Masks to apply in order
+ * @param count Number of masks
+ * @return 0 on success, -1 on error
+ */
+ static int write_masks(int fd, const struct gpio_led_mask *masks, size_t count) {
+    ssize_t bytes;
+
+    bytes = write(fd, masks, count * sizeof(*masks));
+    if (bytes != (ssize_t)(count * sizeof(*masks))) {
+        perror("Error writing masks");
+        return -1;
+    }
+
+    /* Queued mode applies writes asynchronously */
+    if (ioctl(fd, GPIO_LED_IOC_SYNC) < 0) {
+        perror("Error syncing");
+        return -1;
+    }
+    return 0;
+ }
+
+ /**
+ * @brief Check bank masks, levels, PWM and the sequencer
+ * 
+ * Works on every managed output. Inputs are found by the driver
+ * rejecting them in a mask and are left alone.
+ * 
+ * @param fd File descriptor for /dev/gpio_bank
+ * @return 0 on success, -1 on error
+ */
+ static int selftest(int fd) {
+    struct gpio_led_levels levels;
+    struct gpio_led_mask masks[2];
+    struct gpio_led_pwm pwm;
+    struct gpio_led_step steps[2];
+    struct gpio_led_seq seq;
+    uint64_t outputs = 0, pattern = 0, first;
+    unsigned int gpio, n = 0;
+
+    if (ioctl(fd, GPIO_LED_IOC_GET_LEVELS, &levels) < 0) {
+        perror("Error reading levels");
+        return -1;
+    }
+
+    /* Managed pins the driver accepts in a clear mask are outputs */
+    for (gpio = 0; gpio < 64; gpio++) {
+        masks[0].set = 0;
+        masks[0].clear = 1ULL << gpio;
+        if (!(levels.mask & masks[0].clear))
+            continue;
+        if (ioctl(fd, GPIO_LED_IOC_SET_CLEAR, &masks[0]) == 0) {
+            outputs |= masks[0].clear;
+            if (n++ % 2 == 0)
+                pattern |= masks[0].clear;
+        }
+    }
+    if (!outputs) {
+        printf("No managed outputs\n");
+        return -1;
+    }
+    first = outputs & -outputs;
+    printf("Testing outputs 0x%016llx\n", (unsigned long long)outputs);
+
+    /* All low, then every other output high */
+    masks[0].set = 0;
+    masks[0].clear = outputs;
+    if (write_masks(fd, masks, 1) < 0 || check_levels(fd, outputs, 0, "clear all") < 0)
+        return -1;
+
+    masks[0].set = pattern;
+    masks[0].clear = outputs & ~pattern;
+    if (write_masks(fd, masks, 1) < 0 ||
+        check_levels(fd, outputs, pattern, "alternating pattern") < 0)
+        return -1;
+
+    /* Two masks in one write are applied in order */
+    masks[0].set = outputs;
+    masks[0].clear = 0;
+    masks[1].set = 0;
+    masks[1].clear = first;
+    if (write_masks(fd, masks, 2) < 0 ||
+        check_levels(fd, outputs, outputs & ~first, "mask array") < 0)
+        return -1;
+
+    /* A pin in both masks is rejected */
+    masks[0].set = first;
+    masks[0].clear = first;
+    if (ioctl(fd, GPIO_LED_IOC_SET_CLEAR, &masks[0]) == 0 || errno != EINVAL) {
+        printf("FAIL overlapping masks were not rejected\n");
+        return -1;
+    }
+    printf("ok   overlapping masks rejected\n");
+
+    /* Full and zero duty hold the pin statically */
+    pwm.gpio = __builtin_ctzll(first);
+    pwm.duty = GPIO_LED_PWM_MAX;
+    if (ioctl(fd, GPIO_LED_IOC_SET_PWM, &pwm) < 0) {
+        perror("Error setting PWM");
+        return -1;
+    }
+    if (check_levels(fd, first, first, "PWM full duty") < 0)
+        return -1;
+
+    pwm.duty = GPIO_LED_PWM_MAX / 2;
+    if (ioctl(fd, GPIO_LED_IOC_SET_PWM, &pwm) < 0) {
+        perror("Error setting PWM");
+        return -1;
+    }
+    pwm.duty = 0;
+    if (ioctl(fd, GPIO_LED_IOC_SET_PWM, &pwm) < 0) {
+        perror("Error setting PWM");
+        return -1;
+    }
+    if (check_levels(fd, first, 0, "PWM zero duty") < 0)
+        return -1;
+
+    pwm.duty = GPIO_LED_PWM_MAX + 1;
+    if (ioctl(fd, GPIO_LED_IOC_SET_PWM, &pwm) == 0 || errno != EINVAL) {
+        printf("FAIL out of range duty was not rejected\n");
+        return -1;
+    }
+    printf("ok   out of range duty rejected\n");
+
+    /* A two-step sequence ends with only the first output low */
+    memset(steps, 0, sizeof(steps));
+    steps[0].mask = outputs;
+    steps[0].level = 1;
+    steps[0].duration_ns = SEQ_STEP_NS;
+    steps[1].mask = first;
+    steps[1].level = 0;
+    steps[1].duration_ns = SEQ_STEP_NS;
+    memset(&seq, 0, sizeof(seq));
+    seq.steps = (uintptr_t)steps;
+    seq.count = 2;
+    if (ioctl(fd, GPIO_LED_IOC_SEQ_START, &seq) < 0) {
+        perror("Error starting sequence");
+        return -1;
+    }
+    usleep(3 * SEQ_STEP_NS / 1000);
+    if (ioctl(fd, GPIO_LED_IOC_SEQ_STOP) < 0) {
+        perror("Error stopping sequence");
+        return -1;
+    }
+    if (check_levels(fd, outputs, outputs & ~first, "sequencer") < 0)
+        return -1;
+
+    /* Leave every output off */
+    masks[0].set = 0;
+    masks[0].clear = outputs;
+    if (write_masks(fd, masks, 1) < 0)
+        return -1;
+
+    printf("All checks passed\n");
+    return 0;
+ }
+
  int main(int argc, char *argv[]) {
+    const char *device = DEVICE_PATH;
     int fd;
     int ret = EXIT_SUCCESS;
 
     /* Check for correct number of arguments */
-    if (argc != 2) {
+    if (argc != 2 && argc != 3) {
         print_usage(argv[0]);
         return EXIT_FAILURE;
     }
 
+    /* Optional device file selects the pin */
+    if (argc == 3) {
+        device = argv[2];
+    } else if (strcmp(argv[1], "selftest") == 0) {
+        device = BANK_PATH;
+    }
+
     /* Open the device for reading and writing */
-    printf("Opening %s...\n", DEVICE_PATH);
+    printf("Opening %s...\n", device);
 
-    fd = open(DEVICE_PATH, O_RDWR);
+    fd = open(device, O_RDWR);
     /* Check if device open successfully */
     if (fd < 0) {
         perror("Error opening device");
@@ -136,6 +340,11 @@
             ret = EXIT_FAILURE;
         }
     }
+    else if (strcmp(argv[1], "selftest") == 0) {
+        if (selftest(fd) < 0) {
+            ret = EXIT_FAILURE;
+        }
+    }
     else {
         printf("Unknown command: %s\n", argv[1]);
         print_usage(argv[0]);